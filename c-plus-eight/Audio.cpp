@@ -0,0 +1,116 @@
+/**
+ * Audio.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include "Audio.h"
+#include "spdlog/spdlog.h"
+
+// beeper pitch and volume
+#define TONE_HZ 440
+#define AMPLITUDE 3000
+
+namespace c_plus_eight {
+	bool Audio::start_device(uint16_t samples)
+	{
+		// initialize SDL audio
+		if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+			spdlog::get("logger")->error("Could not initialize SDL audio. SDL Error: {}", SDL_GetError());
+			return false;
+		}
+
+		// request a small mono buffer to keep output latency low
+		SDL_AudioSpec want;
+		SDL_AudioSpec have;
+		SDL_zero(want);
+		want.freq = this->sample_rate;
+		want.format = AUDIO_S16SYS;
+		want.channels = 1;
+		want.samples = samples;
+		want.callback = Audio::callback;
+		want.userdata = this;
+
+		this->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+		if (this->device == 0) {
+			spdlog::get("logger")->error("Could not open audio device. SDL Error: {}", SDL_GetError());
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+			return false;
+		}
+
+		this->sample_rate = have.freq;
+		this->buffer_samples = have.samples;
+		this->half_period = this->sample_rate / (2 * TONE_HZ);
+
+		spdlog::get("logger")->info("Audio device opened ({} Hz, {} samples).", have.freq, have.samples);
+
+		SDL_PauseAudioDevice(this->device, 0);
+		return true;
+	}
+
+	// Map an emulated cycle onto the output sample clock
+	uint64_t Audio::sample_for(uint64_t cycle) const
+	{
+		return this->anchor_sample + ((cycle - this->anchor_cycle) * this->sample_rate) / this->cycles_per_second;
+	}
+
+	// Fill a buffer with the square wave, gating it at the sample each event maps to
+	void Audio::render(int16_t* out, uint32_t count)
+	{
+		uint64_t start = this->sample_clock;
+		uint64_t end = start + count;
+
+		// the emulator runs a frame at a time, so events may legitimately be up to
+		// about two frames ahead of the samples being played
+		uint64_t max_ahead = (this->sample_rate / 30) + this->buffer_samples;
+
+		uint32_t i = 0;
+		SoundEvent ev;
+		while (this->events.peek(ev)) {
+			// (re)anchor the cycle->sample mapping on the first event, when the
+			// emulator fell behind (events in the past) or ran too far ahead
+			uint64_t at = this->anchored ? this->sample_for(ev.cycle) : start;
+			if (!this->anchored || at < start + i || at > end + max_ahead) {
+				this->anchor_cycle = ev.cycle;
+				this->anchor_sample = start + i;
+				this->anchored = true;
+				at = this->anchor_sample;
+			} // end if (!anchored)
+
+			if (at >= end) {
+				break;
+			} // end if (at >= end)
+
+			// play up to the event, then apply it
+			for (; start + i < at; i++) {
+				out[i] = this->gate ? ((this->phase < this->half_period) ? AMPLITUDE : -AMPLITUDE) : 0;
+				this->phase = (this->phase + 1) % (2 * this->half_period);
+			} // end for (i)
+
+			this->gate = ev.on;
+			this->events.pop(ev);
+		} // end while (peek)
+
+		for (; i < count; i++) {
+			out[i] = this->gate ? ((this->phase < this->half_period) ? AMPLITUDE : -AMPLITUDE) : 0;
+			this->phase = (this->phase + 1) % (2 * this->half_period);
+		} // end for (i)
+
+		this->sample_clock = end;
+	}
+
+	void SDLCALL Audio::callback(void* userdata, Uint8* stream, int len)
+	{
+		Audio* a = static_cast<Audio*>(userdata);
+		a->render(reinterpret_cast<int16_t*>(stream), len / sizeof(int16_t));
+	}
+
+	void Audio::quit()
+	{
+		// free SDL resources
+		if (this->device != 0) {
+			SDL_CloseAudioDevice(this->device);
+			this->device = 0;
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+/**
+ * Audio.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+
+#include <SDL.h>
+
+#include "Chip8.h"
+
+namespace c_plus_eight {
+	struct audio_creation_failed_error : public std::exception {
+		const char* what() const throw() {
+			return "Could not open audio device.";
+		}
+	};
+
+	class Audio
+	{
+	private:
+		SDL_AudioDeviceID device = 0;
+
+		/* Output sample rate and emulated clock rate used to place events */
+		int sample_rate = 0;
+		uint64_t cycles_per_second = 0;
+
+		/* Events from the emulation thread */
+		SoundEventRing events;
+
+		/* Callback thread state (never touched by the emulation thread) */
+		uint64_t sample_clock = 0;
+		uint64_t anchor_cycle = 0;
+		uint64_t anchor_sample = 0;
+		bool anchored = false;
+		bool gate = false;
+		uint32_t phase = 0;
+		uint32_t half_period = 0;
+		uint32_t buffer_samples = 0;
+
+		bool start_device(uint16_t samples);
+		uint64_t sample_for(uint64_t cycle) const;
+		void render(int16_t* out, uint32_t count);
+
+		static void SDLCALL callback(void* userdata, Uint8* stream, int len);
+
+	public:
+		Audio(uint64_t cps, int rate = 44100, uint16_t samples = 256): sample_rate(rate), cycles_per_second(cps) {
+			if (!this->start_device(samples)) {
+				throw audio_creation_failed_error();
+			}
+		}
+
+		~Audio() {
+			this->quit();
+		}
+
+		SoundEventRing* get_events() { return &this->events; }
+		void quit();
+	};
+}
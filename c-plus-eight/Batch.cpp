@@ -0,0 +1,666 @@
+/**
+ * Batch.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "Batch.h"
+
+namespace c_plus_eight {
+	/* Register operations the vector path applies to all active lanes */
+	enum class LaneOp {
+		Set,        // Vx = kk
+		Add,        // Vx += kk
+		Move,       // Vx = Vy
+		Or,
+		And,
+		Xor,
+		AddCarry,   // 8xy4
+		Sub,        // 8xy5
+		Shr,        // 8xy6
+		SubN,       // 8xy7
+		Shl         // 8xyE
+	};
+
+#ifdef __AVX2__
+	// Unsigned p > q for each byte
+	static inline __m256i gt_epu8(__m256i p, __m256i q)
+	{
+		return _mm256_andnot_si256(_mm256_cmpeq_epi8(p, q), _mm256_cmpeq_epi8(_mm256_max_epu8(p, q), p));
+	}
+#endif
+
+	/**
+	 * Apply one register operation to every lane whose mask byte is 0xFF, in
+	 * the same order as the Chip8 opcode functions: VF is written before the
+	 * result is computed, so operations with x or y = F come out the same.
+	 * vy may alias vx or vf.
+	 */
+	static void lane_alu(LaneOp op, uint8_t* vx, const uint8_t* vy, uint8_t kk, uint8_t* vf,
+		const uint8_t* mask, size_t n, uint8_t quirks)
+	{
+		size_t i = 0;
+
+#ifdef __AVX2__
+		const __m256i one = _mm256_set1_epi8(1);
+		for (; i + 32 <= n; i += 32) {
+			__m256i m = _mm256_loadu_si256((const __m256i*)(mask + i));
+			auto load = [i](const uint8_t* p) { return _mm256_loadu_si256((const __m256i*)(p + i)); };
+			auto store = [i, m](uint8_t* p, __m256i v) {
+				__m256i old = _mm256_loadu_si256((const __m256i*)(p + i));
+				_mm256_storeu_si256((__m256i*)(p + i), _mm256_blendv_epi8(old, v, m));
+			};
+
+			switch (op) {
+			case LaneOp::Set:
+				store(vx, _mm256_set1_epi8((char)kk));
+				break;
+			case LaneOp::Add:
+				store(vx, _mm256_add_epi8(load(vx), _mm256_set1_epi8((char)kk)));
+				break;
+			case LaneOp::Move:
+				store(vx, load(vy));
+				break;
+			case LaneOp::Or:
+				store(vx, _mm256_or_si256(load(vx), load(vy)));
+				break;
+			case LaneOp::And:
+				store(vx, _mm256_and_si256(load(vx), load(vy)));
+				break;
+			case LaneOp::Xor:
+				store(vx, _mm256_xor_si256(load(vx), load(vy)));
+				break;
+			case LaneOp::AddCarry:
+				store(vf, _mm256_and_si256(gt_epu8(load(vy), _mm256_xor_si256(load(vx), _mm256_set1_epi8(-1))), one));
+				store(vx, _mm256_add_epi8(load(vx), load(vy)));
+				break;
+			case LaneOp::Sub:
+				store(vf, _mm256_and_si256(gt_epu8(load(vx), load(vy)), one));
+				store(vx, _mm256_sub_epi8(load(vx), load(vy)));
+				break;
+			case LaneOp::SubN:
+				store(vf, _mm256_and_si256(gt_epu8(load(vy), load(vx)), one));
+				store(vx, _mm256_sub_epi8(load(vy), load(vx)));
+				break;
+			case LaneOp::Shr:
+				if (quirks & QUIRK_SHIFT_VY) {
+					store(vx, load(vy));
+				}
+				store(vf, _mm256_and_si256(load(vx), one));
+				store(vx, _mm256_and_si256(_mm256_srli_epi16(load(vx), 1), _mm256_set1_epi8(0x7F)));
+				break;
+			case LaneOp::Shl:
+				if (quirks & QUIRK_SHIFT_VY) {
+					store(vx, load(vy));
+				}
+				store(vf, _mm256_and_si256(_mm256_srli_epi16(load(vx), 7), one));
+				store(vx, _mm256_add_epi8(load(vx), load(vx)));
+				break;
+			} // end switch (op)
+
+			if ((quirks & QUIRK_VF_RESET) && (op == LaneOp::Or || op == LaneOp::And || op == LaneOp::Xor)) {
+				store(vf, _mm256_setzero_si256());
+			} // end if (QUIRK_VF_RESET)
+		} // end for (i)
+#endif
+
+		// remaining lanes (all of them without AVX2)
+		for (; i < n; i++) {
+			if (mask[i] == 0) {
+				continue;
+			} // end if (mask[i] == 0)
+
+			switch (op) {
+			case LaneOp::Set:
+				vx[i] = kk;
+				break;
+			case LaneOp::Add:
+				vx[i] += kk;
+				break;
+			case LaneOp::Move:
+				vx[i] = vy[i];
+				break;
+			case LaneOp::Or:
+				vx[i] |= vy[i];
+				break;
+			case LaneOp::And:
+				vx[i] &= vy[i];
+				break;
+			case LaneOp::Xor:
+				vx[i] ^= vy[i];
+				break;
+			case LaneOp::AddCarry:
+				vf[i] = (vy[i] > (0xFF - vx[i])) ? 1 : 0;
+				vx[i] += vy[i];
+				break;
+			case LaneOp::Sub:
+				vf[i] = (vx[i] > vy[i]) ? 1 : 0;
+				vx[i] -= vy[i];
+				break;
+			case LaneOp::SubN:
+				vf[i] = (vy[i] > vx[i]) ? 1 : 0;
+				vx[i] = vy[i] - vx[i];
+				break;
+			case LaneOp::Shr:
+				if (quirks & QUIRK_SHIFT_VY) {
+					vx[i] = vy[i];
+				}
+				vf[i] = vx[i] & 0x1;
+				vx[i] >>= 1;
+				break;
+			case LaneOp::Shl:
+				if (quirks & QUIRK_SHIFT_VY) {
+					vx[i] = vy[i];
+				}
+				vf[i] = (vx[i] & 0x80) >> 7;
+				vx[i] <<= 1;
+				break;
+			} // end switch (op)
+
+			if ((quirks & QUIRK_VF_RESET) && (op == LaneOp::Or || op == LaneOp::And || op == LaneOp::Xor)) {
+				vf[i] = 0;
+			} // end if (QUIRK_VF_RESET)
+		} // end for (i)
+	}
+
+	// Whether op is one the vector path runs (without MEASURE_LATENCY, key skips too: single lanes feed the probe)
+	static bool has_vector_form(uint16_t op)
+	{
+		switch (op & 0xF000) {
+		case 0x1000:
+		case 0x3000:
+		case 0x4000:
+		case 0x5000:
+		case 0x6000:
+		case 0x7000:
+		case 0x9000:
+		case 0xA000:
+			return true;
+		case 0x2000:
+		case 0xC000:
+		case 0xD000:
+			return true;
+		case 0x0000:
+			return op == 0x00EE;
+		case 0x8000:
+			return OPCODE_NIBBLE(op) <= 0x7 || OPCODE_NIBBLE(op) == 0xE;
+#ifndef MEASURE_LATENCY
+		case 0xE000:
+			return OPCODE_BYTE(op) == 0x9E || OPCODE_BYTE(op) == 0xA1;
+#endif
+		case 0xF000:
+			return OPCODE_BYTE(op) == 0x07 || OPCODE_BYTE(op) == 0x15 || OPCODE_BYTE(op) == 0x1E || OPCODE_BYTE(op) == 0x29;
+		default:
+			return false;
+		} // end switch (op & 0xF000)
+	}
+
+	BatchEngine::BatchEngine(const Chip8& prototype, size_t lanes)
+		: lanes(lanes), quirks(prototype.quirks), cycles(prototype.cycles), frames(prototype.frames)
+	{
+		for (std::vector<uint8_t>& reg : this->V) {
+			reg.resize(lanes);
+		}
+		this->I.resize(lanes);
+		this->pc.resize(lanes);
+		this->delay_timer.resize(lanes);
+		this->sound_timer.resize(lanes);
+		this->keys.resize(lanes);
+		this->halted.resize(lanes);
+		this->loaded.resize(lanes);
+		this->done.resize(lanes);
+		this->group_of.resize(lanes);
+		this->active.resize(lanes);
+		this->group_at.fill(BATCH_NO_GROUP);
+		this->written.fill(0);
+
+		for (size_t r = 0; r < 16; r++) {
+			std::fill(this->V[r].begin(), this->V[r].end(), prototype.V[r]);
+		} // end for (r)
+		std::fill(this->I.begin(), this->I.end(), prototype.I);
+		std::fill(this->pc.begin(), this->pc.end(), prototype.pc);
+		std::fill(this->delay_timer.begin(), this->delay_timer.end(), prototype.delay_timer);
+		std::fill(this->sound_timer.begin(), this->sound_timer.end(), prototype.sound_timer);
+		std::fill(this->keys.begin(), this->keys.end(), prototype.keys);
+		std::fill(this->halted.begin(), this->halted.end(), prototype.waiting_for_key ? 0xFF : 0x00);
+
+		this->machines.reserve(lanes);
+		for (size_t i = 0; i < lanes; i++) {
+			this->machines.push_back(prototype.clone());
+		} // end for (i)
+
+		for (size_t k = 0; k < MEMORY_PAGES; k++) {
+			this->shared_pages[k] = prototype.pages[k];
+		} // end for (k)
+	}
+
+	// Move a lane's registers into its machine, if they are not there already, and bring its clock up to date
+	Chip8& BatchEngine::load_lane(size_t lane)
+	{
+		Chip8& m = *this->machines[lane];
+		if (!this->loaded[lane]) {
+			for (size_t r = 0; r < 16; r++) {
+				m.V[r] = this->V[r][lane];
+			} // end for (r)
+			m.I = this->I[lane];
+			m.pc = this->pc[lane];
+			m.delay_timer = this->delay_timer[lane];
+			m.sound_timer = this->sound_timer[lane];
+			this->loaded[lane] = 0xFF;
+			this->loaded_lanes++;
+		} // end if (!loaded)
+		m.cycles = this->cycles + this->done[lane];
+		m.frames = this->frames;
+		return m;
+	}
+
+	// Move a lane's registers back out of its machine, for the vector path
+	void BatchEngine::store_lane(size_t lane)
+	{
+		if (!this->loaded[lane]) {
+			return;
+		} // end if (!loaded)
+
+		const Chip8& m = *this->machines[lane];
+		for (size_t r = 0; r < 16; r++) {
+			this->V[r][lane] = m.V[r];
+		} // end for (r)
+		this->I[lane] = m.I;
+		this->delay_timer[lane] = m.delay_timer;
+		this->sound_timer[lane] = m.sound_timer;
+		this->loaded[lane] = 0;
+		this->loaded_lanes--;
+	}
+
+	/**
+	 * Run one instruction of one lane on its own machine. Unless the lane is
+	 * loaded, the machine gets only what the instruction can touch: V0, Vx, Vy,
+	 * VF (V0 to Vx for Fx55/Fx65), I and the timers, which go back afterwards.
+	 */
+	void BatchEngine::step_lane(size_t lane)
+	{
+		Chip8& m = *this->machines[lane];
+		m.cycles = this->cycles + this->done[lane];
+		m.frames = this->frames;
+		uint16_t addr = this->loaded[lane] ? m.I : this->I[lane];
+		if (this->loaded[lane]) {
+			m.emulate_cycle();
+		}
+		else {
+			uint16_t p = this->pc[lane];
+			uint16_t op = (m.read_memory(p) << 8) | m.read_memory(p + 1);
+			uint8_t x = OPCODE_X(op);
+			uint8_t y = OPCODE_Y(op);
+			uint8_t last = ((op & 0xF0FF) == 0xF055 || (op & 0xF0FF) == 0xF065) ? x : 0;
+
+			for (uint8_t r = 0; r <= last; r++) {
+				m.V[r] = this->V[r][lane];
+			} // end for (r)
+			m.V[x] = this->V[x][lane];
+			m.V[y] = this->V[y][lane];
+			m.V[0xF] = this->V[0xF][lane];
+			m.I = this->I[lane];
+			m.pc = p;
+			m.delay_timer = this->delay_timer[lane];
+			m.sound_timer = this->sound_timer[lane];
+
+			m.emulate_cycle();
+
+			for (uint8_t r = 0; r <= last; r++) {
+				this->V[r][lane] = m.V[r];
+			} // end for (r)
+			this->V[x][lane] = m.V[x];
+			this->V[y][lane] = m.V[y];
+			this->V[0xF][lane] = m.V[0xF];
+			this->I[lane] = m.I;
+			this->delay_timer[lane] = m.delay_timer;
+			this->sound_timer[lane] = m.sound_timer;
+		} // end if (loaded)
+		this->pc[lane] = m.pc;
+		this->halted[lane] = m.waiting_for_key ? 0xFF : 0x00;
+		this->done[lane]++;
+		this->scalar_steps++;
+
+		// the bytes a store wrote may now differ from the other lanes'
+		if ((m.opcode & 0xF0FF) == 0xF033 || (m.opcode & 0xF0FF) == 0xF055) {
+			uint8_t last = ((m.opcode & 0xF0FF) == 0xF033) ? 2 : OPCODE_X(m.opcode);
+			for (uint8_t k = 0; k <= last; k++) {
+				this->written[(addr + k) & 0xFFF] = 0xFF;
+			} // end for (k)
+		} // end if (memory store)
+	}
+
+	// Step one lane on its own machine up to the next instruction the vector path has, or the end of its frame of cycles
+	void BatchEngine::run_lane(size_t lane, unsigned int cycles)
+	{
+		const Chip8& m = *this->machines[lane];
+		do {
+			this->step_lane(lane);
+		} while (this->done[lane] < cycles && !this->halted[lane]
+			&& !has_vector_form((m.read_memory(m.pc) << 8) | m.read_memory(m.pc + 1)));
+	}
+
+	// Run one lane on its own machine to the end of its frame of cycles
+	void BatchEngine::finish_lane(size_t lane, unsigned int cycles)
+	{
+		Chip8& m = this->load_lane(lane);
+		uint32_t start = this->done[lane];
+		for (; this->done[lane] < cycles && !m.waiting_for_key; this->done[lane]++) {
+			m.emulate_cycle();
+		} // end for (done)
+		this->pc[lane] = m.pc;
+		this->halted[lane] = m.waiting_for_key ? 0xFF : 0x00;
+		this->scalar_steps += this->done[lane] - start;
+
+		// it may have stored anywhere in a page it no longer shares
+		for (size_t k = 0; k < MEMORY_PAGES; k++) {
+			if (m.pages[k] != this->shared_pages[k] && !(this->private_pages & (1 << k))) {
+				std::fill_n(this->written.begin() + k * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE, 0xFF);
+				this->private_pages |= (uint16_t)(1 << k);
+			}
+		} // end for (k)
+	}
+
+	// Run op, which has_vector_form(), on every active lane at once
+	void BatchEngine::step_vector(uint16_t op)
+	{
+		uint8_t x = OPCODE_X(op);
+		uint8_t y = OPCODE_Y(op);
+		uint8_t n = OPCODE_NIBBLE(op);
+		uint8_t kk = OPCODE_BYTE(op);
+		uint16_t nnn = OPCODE_ADDR(op);
+		const uint8_t* mask = this->active.data();
+		size_t count = this->lanes;
+
+		// next pc: 2 for plain instructions, 4 for taken skips
+		int skip = -1;  // -1 = no skip instruction
+		const uint8_t* skip_a = NULL;
+		const uint8_t* skip_b = NULL;
+
+		switch (op & 0xF000) {
+		case 0x0000:
+		case 0x2000:
+			// the stack stays in each lane's machine, which checks it
+			for (size_t i = 0; i < count; i++) {
+				if (mask[i]) {
+					Chip8& m = *this->machines[i];
+					m.pc = this->pc[i];
+					if (op == 0x00EE) {
+						m.op_ret();
+					}
+					else {
+						m.op_call_nnn(nnn);
+					} // end if (op == 0x00EE)
+					this->pc[i] = m.pc;
+				}
+			} // end for (i)
+			return;
+		case 0x1000:
+			for (size_t i = 0; i < count; i++) {
+				this->pc[i] = mask[i] ? nnn : this->pc[i];
+			} // end for (i)
+			return;
+		case 0x3000:
+		case 0x4000:
+			skip = ((op & 0xF000) == 0x3000) ? 1 : 0;
+			skip_a = this->V[x].data();
+			break;
+		case 0x5000:
+		case 0x9000:
+			skip = ((op & 0xF000) == 0x5000) ? 1 : 0;
+			skip_a = this->V[x].data();
+			skip_b = this->V[y].data();
+			break;
+		case 0x6000:
+			lane_alu(LaneOp::Set, this->V[x].data(), NULL, kk, this->V[0xF].data(), mask, count, this->quirks);
+			break;
+		case 0x7000:
+			lane_alu(LaneOp::Add, this->V[x].data(), NULL, kk, this->V[0xF].data(), mask, count, this->quirks);
+			break;
+		case 0x8000: {
+			static const LaneOp ops[16] = {
+				LaneOp::Move, LaneOp::Or, LaneOp::And, LaneOp::Xor, LaneOp::AddCarry, LaneOp::Sub, LaneOp::Shr, LaneOp::SubN,
+				LaneOp::Move, LaneOp::Move, LaneOp::Move, LaneOp::Move, LaneOp::Move, LaneOp::Move, LaneOp::Shl, LaneOp::Move
+			};
+			lane_alu(ops[n], this->V[x].data(), this->V[y].data(), 0, this->V[0xF].data(), mask, count, this->quirks);
+			break;
+		} // end case 0x8000
+		case 0xA000:
+			for (size_t i = 0; i < count; i++) {
+				this->I[i] = mask[i] ? nnn : this->I[i];
+			} // end for (i)
+			break;
+		case 0xC000: {
+			uint8_t* vx = this->V[x].data();
+			for (size_t i = 0; i < count; i++) {
+				if (mask[i]) {
+					vx[i] = (this->machines[i]->next_random() >> 24) & kk;
+				}
+			} // end for (i)
+			break;
+		} // end case 0xC000
+		case 0xD000: {
+			// sprites go to each lane's own screen, read from its own memory
+			const uint8_t* vx = this->V[x].data();
+			const uint8_t* vy = this->V[y].data();
+			uint8_t* vf = this->V[0xF].data();
+			for (size_t i = 0; i < count; i++) {
+				if (mask[i]) {
+					vf[i] = this->machines[i]->draw_sprite(vx[i], vy[i], this->I[i], n) ? 1 : 0;
+				}
+			} // end for (i)
+			break;
+		} // end case 0xD000
+		case 0xE000: {
+			const uint8_t* vx = this->V[x].data();
+			for (size_t i = 0; i < count; i++) {
+				bool pressed = (this->keys[i] >> (vx[i] & 0xF)) & 0x1;
+				this->pc[i] += mask[i] ? ((pressed == (kk == 0x9E)) ? 4 : 2) : 0;
+			} // end for (i)
+			return;
+		} // end case 0xE000
+		case 0xF000:
+			if (kk == 0x29) {
+				const uint8_t* vx = this->V[x].data();
+				for (size_t i = 0; i < count; i++) {
+					this->I[i] = mask[i] ? FONTSET_BYTES_PER_CHAR * vx[i] : this->I[i];
+				} // end for (i)
+			}
+			else if (kk == 0x07) {
+				lane_alu(LaneOp::Move, this->V[x].data(), this->delay_timer.data(), 0, this->V[0xF].data(), mask, count, this->quirks);
+			}
+			else if (kk == 0x15) {
+				lane_alu(LaneOp::Move, this->delay_timer.data(), this->V[x].data(), 0, this->V[0xF].data(), mask, count, this->quirks);
+			}
+			else {
+				const uint8_t* vx = this->V[x].data();
+				for (size_t i = 0; i < count; i++) {
+					this->I[i] += mask[i] ? vx[i] : 0;
+				} // end for (i)
+			} // end if (kk)
+			break;
+		} // end switch (op & 0xF000)
+
+		if (skip < 0) {
+			for (size_t i = 0; i < count; i++) {
+				this->pc[i] += mask[i] ? 2 : 0;
+			} // end for (i)
+		}
+		else {
+			for (size_t i = 0; i < count; i++) {
+				bool equal = skip_a[i] == ((skip_b != NULL) ? skip_b[i] : kk);
+				this->pc[i] += mask[i] ? ((equal == (skip == 1)) ? 4 : 2) : 0;
+			} // end for (i)
+		} // end if (skip < 0)
+	}
+
+	// Run op on the active lanes, at once if the vector path has it and otherwise each on its own machine
+	void BatchEngine::step_group(uint16_t op, unsigned int cycles)
+	{
+		if (!has_vector_form(op)) {
+			for (size_t i = 0; i < this->lanes; i++) {
+				if (this->active[i]) {
+					this->run_lane(i, cycles);
+				}
+			} // end for (i)
+			return;
+		} // end if (!has_vector_form)
+
+		if (this->loaded_lanes > 0) {
+			for (size_t i = 0; i < this->lanes; i++) {
+				if (this->active[i] & this->loaded[i]) {
+					this->store_lane(i);
+				}
+			} // end for (i)
+		} // end if (loaded_lanes > 0)
+		this->step_vector(op);
+
+		size_t together = 0;
+		for (size_t i = 0; i < this->lanes; i++) {
+			this->done[i] += this->active[i] & 1;
+			together += this->active[i] & 1;
+		} // end for (i)
+		this->vector_steps += together;
+	}
+
+	// Advance every lane at least one cycle towards the end of the frame; returns false once all are there or halted
+	bool BatchEngine::step(unsigned int cycles)
+	{
+		// mostly all the lanes are at the same pc, which is quick to check for
+		uint16_t p = this->pc[0];
+		uint8_t idle = 0;
+		uint16_t spread = 0;
+		for (size_t i = 0; i < this->lanes; i++) {
+			idle |= this->halted[i] | ((this->done[i] >= cycles) ? 0xFF : 0x00);
+			spread |= this->pc[i] ^ p;
+		} // end for (i)
+		size_t smallest = std::max<size_t>(2, this->lanes / BATCH_MIN_SHARE);
+		uint8_t rewritten = this->written[p & 0xFFF] | this->written[(p + 1) & 0xFFF];
+		if (this->lanes >= smallest && idle == 0 && spread == 0 && rewritten == 0) {
+			const Chip8& m = *this->machines[0];
+			std::fill(this->active.begin(), this->active.end(), 0xFF);
+			this->step_group((m.read_memory(p) << 8) | m.read_memory(p + 1), cycles);
+			return true;
+		} // end if (all together)
+
+		// otherwise the first lane at each pc opens a group there
+		size_t groups = 0;
+		for (size_t i = 0; i < this->lanes; i++) {
+			uint8_t g = BATCH_NO_GROUP;
+			p = this->pc[i];
+			if (!this->halted[i] && this->done[i] < cycles) {
+				const Chip8& m = *this->machines[i];
+				uint8_t& slot = this->group_at[p & 0xFFF];
+				if (slot == BATCH_NO_GROUP && groups < BATCH_MAX_GROUPS) {
+					slot = (uint8_t)groups;
+					this->group_pc[groups] = p;
+					this->group_op[groups] = (m.read_memory(p) << 8) | m.read_memory(p + 1);
+					this->group_size[groups] = 0;
+					groups++;
+				} // end if (new group)
+
+				// the group runs the same instruction, unless some lane rewrote the code there
+				rewritten = this->written[p & 0xFFF] | this->written[(p + 1) & 0xFFF];
+				if (slot != BATCH_NO_GROUP && this->group_pc[slot] == p && (rewritten == 0
+					|| ((m.read_memory(p) << 8) | m.read_memory(p + 1)) == this->group_op[slot])) {
+					g = slot;
+					this->group_size[g]++;
+				} // end if (in group)
+			} // end if (running)
+			this->group_of[i] = g;
+		} // end for (i)
+
+		bool grouped = false;
+		for (size_t g = 0; g < groups; g++) {
+			this->group_at[this->group_pc[g] & 0xFFF] = BATCH_NO_GROUP;
+			if (this->group_size[g] < smallest) {
+				continue;
+			} // end if (too small)
+			grouped = true;
+
+			for (size_t i = 0; i < this->lanes; i++) {
+				this->active[i] = (this->group_of[i] == g) ? 0xFF : 0x00;
+			} // end for (i)
+			this->step_group(this->group_op[g], cycles);
+		} // end for (g)
+
+		// lanes on their own have drifted away from the rest
+		for (size_t i = 0; i < this->lanes; i++) {
+			uint8_t g = this->group_of[i];
+			if (g != BATCH_NO_GROUP ? this->group_size[g] < smallest : (!this->halted[i] && this->done[i] < cycles)) {
+				this->finish_lane(i, cycles);
+			}
+		} // end for (i)
+
+		// without a group, every lane that was running has now finished the frame or halted
+		return grouped;
+	}
+
+	void BatchEngine::tick()
+	{
+		// the arrays' timers of loaded lanes are stale and get overwritten when the lanes are stored
+		for (size_t i = 0; i < this->lanes; i++) {
+			this->delay_timer[i] -= (this->delay_timer[i] > 0) ? 1 : 0;
+			this->sound_timer[i] -= (this->sound_timer[i] > 0) ? 1 : 0;
+		} // end for (i)
+		for (size_t i = 0; i < this->lanes; i++) {
+			if (this->loaded[i]) {
+				Chip8& m = *this->machines[i];
+				m.delay_timer -= (m.delay_timer > 0) ? 1 : 0;
+				m.sound_timer -= (m.sound_timer > 0) ? 1 : 0;
+			}
+		} // end for (i)
+		this->frames++;
+	}
+
+	// Same as Chip8::run_frame on every lane
+	void BatchEngine::run_frame(unsigned int cycles)
+	{
+		while (this->step(cycles)) {
+		}
+		this->cycles += cycles;
+		std::fill(this->done.begin(), this->done.end(), 0);
+
+		this->tick();
+	}
+
+	void BatchEngine::key_press(size_t lane, uint8_t key_val)
+	{
+		Chip8& m = this->halted[lane] ? this->load_lane(lane) : *this->machines[lane];
+		m.key_press(key_val);
+		this->keys[lane] = m.keys;
+		if (this->halted[lane]) {
+			this->pc[lane] = m.pc;
+			this->halted[lane] = m.waiting_for_key ? 0xFF : 0x00;
+		} // end if (halted)
+	}
+
+	void BatchEngine::key_release(size_t lane, uint8_t key_val)
+	{
+		Chip8& m = *this->machines[lane];
+		m.key_release(key_val);
+		this->keys[lane] = m.keys;
+	}
+
+	void BatchEngine::set_keys(size_t lane, uint16_t state)
+	{
+		Chip8& m = this->halted[lane] ? this->load_lane(lane) : *this->machines[lane];
+		m.set_keys(state);
+		this->keys[lane] = m.keys;
+		if (this->halted[lane]) {
+			this->pc[lane] = m.pc;
+			this->halted[lane] = m.waiting_for_key ? 0xFF : 0x00;
+		} // end if (halted)
+	}
+
+	// Bring a lane's machine up to date and return it
+	const Chip8& BatchEngine::lane(size_t lane)
+	{
+		return this->load_lane(lane);
+	}
+}
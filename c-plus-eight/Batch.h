@@ -0,0 +1,128 @@
+/**
+ * Batch.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Chip8.h"
+
+// Most distinct pcs grouped per cycle before the remaining lanes run one at a time
+#define BATCH_MAX_GROUPS 8
+
+// Smallest group run by the vector path, as a share of the lanes (1/4); smaller ones run one lane at a time
+#define BATCH_MIN_SHARE 4
+
+// Lanes in no group this cycle (BatchEngine::group_of)
+#define BATCH_NO_GROUP 0xFF
+
+namespace c_plus_eight {
+	/**
+	 * Runs many copies of one machine in lockstep. V, I, pc and the timers of
+	 * every lane live here in structure-of-arrays form; the rest of each lane
+	 * (memory, stack, pixels, keypad, RNG) stays in its own Chip8.
+	 *
+	 * The lanes are grouped by pc in one pass (up to BATCH_MAX_GROUPS groups,
+	 * first come first served), over and over until each has run the frame's
+	 * cycles. Lanes need not have run the same number of cycles to be grouped.
+	 * For a group at a register or control-flow instruction (6xkk, 7xkk, 8xy*,
+	 * Annn, 1nnn, skips, Fx07/Fx15/Fx1E/Fx29) the instruction is applied to
+	 * all of its lanes at once, 32 lanes per AVX2 operation when built with
+	 * AVX2. DRW, RND, CALL, RET and the key skips run lane by lane off the
+	 * arrays too, reaching into each lane's Chip8 only for its screen, RNG,
+	 * stack or keypad. The few other instructions (memory stores and loads,
+	 * CLS, Bnnn, Fx0A, Fx18) are run by each lane's own Chip8, lent just the
+	 * registers they can touch. A group smaller than 1/BATCH_MIN_SHARE of the
+	 * lanes has drifted away from the rest: the registers of its lanes move
+	 * into their Chip8s, which run them to the end of the frame in one go, and
+	 * move back when the lanes next join a vector group. Results are identical
+	 * to running each lane with Chip8::run_frame.
+	 *
+	 * Lanes start as clones of one machine and do not drive audio or traces.
+	 */
+	class BatchEngine
+	{
+	private:
+		size_t lanes;
+		std::vector<std::unique_ptr<Chip8>> machines;
+
+		/* Structure-of-arrays registers, one entry per lane */
+		std::array<std::vector<uint8_t>, 16> V;
+		std::vector<uint16_t> I;
+		std::vector<uint16_t> pc;
+		std::vector<uint8_t> delay_timer;
+		std::vector<uint8_t> sound_timer;
+
+		/* Keypad of every lane, copied from its Chip8 whenever it changes */
+		std::vector<uint16_t> keys;
+
+		/* Lanes halted on "LD Vx, K" (0xFF) */
+		std::vector<uint8_t> halted;
+
+		/* Lanes whose V, I and timers are held by their Chip8 instead of the arrays above (0xFF), and how many; pc is kept in both */
+		std::vector<uint8_t> loaded;
+		size_t loaded_lanes = 0;
+
+		/* Cycles each lane has run of the current frame; lanes may be a few apart */
+		std::vector<uint32_t> done;
+
+		/* Group of every lane this cycle, and lanes taking part in the current group's instruction (0xFF) */
+		std::vector<uint8_t> group_of;
+		std::vector<uint8_t> active;
+
+		/* This cycle's groups: pc, instruction and lane count */
+		std::array<uint16_t, BATCH_MAX_GROUPS> group_pc;
+		std::array<uint16_t, BATCH_MAX_GROUPS> group_op;
+		std::array<size_t, BATCH_MAX_GROUPS> group_size;
+
+		/* Group opened at each address this cycle */
+		std::array<uint8_t, MEMORY_PAGES * MEMORY_PAGE_SIZE> group_at;
+
+		/* Memory pages every lane started with, and those found written by a lane running on its own (all marked in written) */
+		std::array<const MemoryPage*, MEMORY_PAGES> shared_pages;
+		uint16_t private_pages = 0;
+
+		/* Addresses some lane may have stored to (0xFF); instructions there are checked lane by lane */
+		std::array<uint8_t, MEMORY_PAGES * MEMORY_PAGE_SIZE> written;
+
+		uint8_t quirks;
+
+		/* Cycles and frames at construction plus those run since, the same for every lane */
+		uint64_t cycles;
+		uint32_t frames;
+
+		/* Instructions executed by the vector path and by single lanes */
+		uint64_t vector_steps = 0;
+		uint64_t scalar_steps = 0;
+
+		Chip8& load_lane(size_t lane);
+		void store_lane(size_t lane);
+		void step_lane(size_t lane);
+		void run_lane(size_t lane, unsigned int cycles);
+		void finish_lane(size_t lane, unsigned int cycles);
+		void step_vector(uint16_t op);
+		void step_group(uint16_t op, unsigned int cycles);
+		bool step(unsigned int cycles);
+		void tick();
+
+	public:
+		BatchEngine(const Chip8& prototype, size_t lanes);
+
+		size_t size() const { return this->lanes; }
+
+		void key_press(size_t lane, uint8_t key_val);
+		void key_release(size_t lane, uint8_t key_val);
+		void set_keys(size_t lane, uint16_t state);
+		void run_frame(unsigned int cycles);
+
+		const Chip8& lane(size_t lane);
+		uint64_t get_vector_steps() const { return this->vector_steps; }
+		uint64_t get_scalar_steps() const { return this->scalar_steps; }
+	};
+}
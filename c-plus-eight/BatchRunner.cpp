@@ -0,0 +1,217 @@
+/**
+ * BatchRunner.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "BatchRunner.h"
+
+namespace c_plus_eight {
+	// Keep the calling thread on one CPU
+	static void pin_to_cpu(unsigned int cpu)
+	{
+#ifdef _WIN32
+		if (cpu < 64) {
+			SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+		}
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+		(void)cpu;
+#endif
+	}
+
+	// threads = 0 uses every hardware thread
+	BatchRunner::BatchRunner(BootCache& cache, unsigned int threads, bool pin_threads)
+		: cache(cache), thread_count(threads), pin_threads(pin_threads)
+	{
+		if (this->thread_count == 0) {
+			this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+		} // end if (thread_count == 0)
+	}
+
+	// Run every job to completion; completed() may be polled from other threads meanwhile
+	void BatchRunner::run(const std::vector<BatchJob>& jobs)
+	{
+		this->jobs = &jobs;
+		this->job_count = jobs.size();
+		this->instances = std::make_unique<Instance[]>(jobs.size());
+		this->results = std::make_unique<BatchResult[]>(jobs.size());
+		this->remaining.store(jobs.size(), std::memory_order_relaxed);
+
+		// deal the jobs out round-robin; a deque never holds more than its share plus a stolen one
+		size_t share = jobs.size() / this->thread_count + 2;
+		this->workers = std::vector<Worker>(this->thread_count);
+		for (Worker& w : this->workers) {
+			w.deque = std::make_unique<StealDeque<uint32_t>>(share);
+		}
+		for (size_t i = jobs.size(); i-- > 0; ) {
+			this->workers[i % this->thread_count].deque->push((uint32_t)i);
+		} // end for (i)
+
+		std::vector<std::thread> threads;
+		for (unsigned int t = 1; t < this->thread_count; t++) {
+			threads.emplace_back(&BatchRunner::work, this, t);
+		}
+		this->work(0);
+		for (std::thread& t : threads) {
+			t.join();
+		}
+
+		this->instances.reset();
+		this->jobs = NULL;
+	}
+
+	void BatchRunner::work(unsigned int index)
+	{
+		// worker 0 is the calling thread, left where it was
+		if (this->pin_threads && index > 0) {
+			pin_to_cpu(index % std::max(1u, std::thread::hardware_concurrency()));
+		} // end if (pin_threads)
+
+		Worker& self = this->workers[index];
+		uint32_t victim = index;
+		while (this->remaining.load(std::memory_order_acquire) > 0) {
+			uint32_t job;
+			bool found = self.deque->pop(job);
+
+			// look around the other workers, starting after the last one robbed
+			for (unsigned int n = 1; !found && n < this->thread_count; n++) {
+				victim = (victim + 1) % this->thread_count;
+				if (victim != index && this->workers[victim].deque->steal(job)) {
+					found = true;
+					self.steals++;
+				}
+			} // end for (n)
+
+			if (!found) {
+				std::this_thread::yield();
+				continue;
+			} // end if (!found)
+
+			self.slices++;
+			if (!this->run_slice(job)) {
+				self.deque->push(job);
+			} // end if (unfinished)
+		} // end while (remaining > 0)
+	}
+
+	// Run one slice of a job, returns true once the job has finished
+	bool BatchRunner::run_slice(uint32_t job)
+	{
+		const BatchJob& spec = (*this->jobs)[job];
+		Instance& inst = this->instances[job];
+		BatchResult& result = this->results[job];
+
+		if (inst.emu == nullptr) {
+			// booting runs the ROM too, and may stop at a bad opcode before the job has a machine
+			try {
+				inst.emu = this->cache.spawn(spec.rom_path.c_str(), spec.boot);
+			}
+			catch (const std::exception& e) {
+				strncpy(result.fault, e.what(), sizeof(result.fault) - 1);
+				this->finish(job, BATCH_FAULT);
+				return true;
+			} // end try
+			if (inst.emu == nullptr) {
+				strncpy(result.fault, "Could not load the ROM.", sizeof(result.fault) - 1);
+				this->finish(job, BATCH_FAULT);
+				return true;
+			} // end if (emu == nullptr)
+
+			inst.end_frame = inst.emu->get_frames() + spec.frames;
+			inst.cycles_per_frame = spec.boot.cycles_per_frame;
+			if (spec.input != NULL) {
+				const std::vector<MovieRecord>& recs = spec.input->get_records();
+				inst.cycles_per_frame = spec.input->get_header().cycles_per_frame;
+				inst.next_record = std::lower_bound(recs.begin(), recs.end(), inst.emu->get_frames(),
+					[](const MovieRecord& r, uint32_t f) { return r.frame < f; }) - recs.begin();
+			} // end if (input != NULL)
+
+			if (spec.keep_frame_hashes) {
+				result.frame_hashes.reserve(spec.frames);
+			} // end if (keep_frame_hashes)
+		} // end if (not started)
+
+		Chip8& emu = *inst.emu;
+		uint32_t stop = std::min(inst.end_frame, emu.get_frames() + BATCH_SLICE_FRAMES);
+		try {
+			while (emu.get_frames() < stop) {
+				if (spec.input != NULL) {
+					const std::vector<MovieRecord>& recs = spec.input->get_records();
+					for (; inst.next_record < recs.size() && recs[inst.next_record].frame <= emu.get_frames(); inst.next_record++) {
+						emu.set_keys(recs[inst.next_record].keys);
+					} // end for (next_record)
+				} // end if (input != NULL)
+
+				emu.run_frame(inst.cycles_per_frame);
+				if (spec.keep_frame_hashes) {
+					result.frame_hashes.push_back(emu.frame_hash());
+				} // end if (keep_frame_hashes)
+			} // end while (frames < stop)
+		}
+		catch (const std::exception& e) {
+			result.fault_pc = emu.get_pc();
+			strncpy(result.fault, e.what(), sizeof(result.fault) - 1);
+			this->finish(job, BATCH_FAULT);
+			return true;
+		} // end try
+
+		if (emu.get_frames() < inst.end_frame) {
+			return false;
+		} // end if (unfinished)
+
+		this->finish(job, BATCH_DONE);
+		return true;
+	}
+
+	// Fill in the end state, publish the result and drop the instance
+	void BatchRunner::finish(uint32_t job, uint8_t status)
+	{
+		Instance& inst = this->instances[job];
+		BatchResult& result = this->results[job];
+
+		if (inst.emu != nullptr) {
+			result.state_hash = inst.emu->state_hash();
+			result.frames = inst.emu->get_frames();
+			if ((*this->jobs)[job].keep_final_state) {
+				result.final_state = std::make_unique<Chip8State>();
+				inst.emu->save_state(*result.final_state);
+			} // end if (keep_final_state)
+			inst.emu.reset();
+		} // end if (emu != nullptr)
+
+		result.status.store(status, std::memory_order_release);
+		this->remaining.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	// Jobs finished so far
+	size_t BatchRunner::completed() const
+	{
+		return this->job_count - this->remaining.load(std::memory_order_relaxed);
+	}
+
+	// Jobs taken from another worker's deque during the last run
+	uint64_t BatchRunner::get_steals() const
+	{
+		uint64_t total = 0;
+		for (const Worker& w : this->workers) {
+			total += w.steals;
+		}
+		return total;
+	}
+}
@@ -0,0 +1,115 @@
+/**
+ * BatchRunner.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BootCache.h"
+#include "Chip8.h"
+#include "Movie.h"
+#include "StealDeque.h"
+
+// Frames an instance runs before its worker looks for other work
+#define BATCH_SLICE_FRAMES 64
+
+/* BatchResult status */
+#define BATCH_PENDING 0
+#define BATCH_DONE 1
+#define BATCH_FAULT 2
+
+namespace c_plus_eight {
+	/* One instance to run: a ROM, where to start it and what to feed it */
+	struct BatchJob {
+		std::string rom_path;
+		BootOptions boot;
+
+		/* Frames to run after booting (the input's cycles per frame wins if set) */
+		uint32_t frames = 600;
+
+		/* Keys to press, by frame number as recorded by Movie; NULL for none */
+		const Movie* input = NULL;
+
+		bool keep_frame_hashes = false;
+		bool keep_final_state = false;
+	};
+
+	/**
+	 * Outcome of a job. Written only by the worker running the job and
+	 * published by the release store to status; read the rest only after
+	 * seeing BATCH_DONE or BATCH_FAULT.
+	 */
+	struct BatchResult {
+		std::atomic<uint8_t> status{ BATCH_PENDING };
+
+		uint64_t state_hash = 0;
+		uint32_t frames = 0;                    // Chip8::get_frames() at the end
+		std::vector<uint64_t> frame_hashes;     // Chip8::frame_hash() after every frame
+		std::unique_ptr<Chip8State> final_state;
+
+		/* Where a faulted job stopped, and why */
+		uint16_t fault_pc = 0;
+		char fault[96] = {};
+	};
+
+	/**
+	 * Runs large sets of independent jobs on all cores. Each worker thread owns
+	 * a work-stealing deque of job numbers; it runs the job at the bottom for
+	 * BATCH_SLICE_FRAMES frames (one run_frame, i.e. run_cycles + tick, per
+	 * frame), puts it back and picks again, so it stays on one instance until
+	 * that finishes while idle workers steal not-yet-started jobs from the top.
+	 *
+	 * Workers are pinned to one CPU each and boot their own instances, so an
+	 * instance's registers and the memory pages it writes are first touched,
+	 * and so allocated, on the node of the worker running it. Results go to a
+	 * preallocated slot per job with no locking.
+	 */
+	class BatchRunner
+	{
+	private:
+		struct Instance {
+			std::unique_ptr<Chip8> emu;
+			uint32_t end_frame = 0;
+			uint32_t cycles_per_frame = 0;
+			size_t next_record = 0;
+		};
+
+		struct alignas(64) Worker {
+			std::unique_ptr<StealDeque<uint32_t>> deque;
+			uint64_t slices = 0;
+			uint64_t steals = 0;
+		};
+
+		BootCache& cache;
+		unsigned int thread_count;
+		bool pin_threads;
+
+		const std::vector<BatchJob>* jobs = NULL;
+		size_t job_count = 0;
+		std::unique_ptr<Instance[]> instances;
+		std::unique_ptr<BatchResult[]> results;
+		std::vector<Worker> workers;
+		std::atomic<size_t> remaining{ 0 };
+
+		void work(unsigned int index);
+		bool run_slice(uint32_t job);
+		void finish(uint32_t job, uint8_t status);
+
+	public:
+		BatchRunner(BootCache& cache, unsigned int threads = 0, bool pin_threads = true);
+
+		void run(const std::vector<BatchJob>& jobs);
+
+		unsigned int get_thread_count() const { return this->thread_count; }
+		size_t completed() const;
+		const BatchResult& result(size_t job) const { return this->results[job]; }
+		uint64_t get_steals() const;
+	};
+}
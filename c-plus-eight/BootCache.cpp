@@ -0,0 +1,189 @@
+/**
+ * BootCache.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include "BootCache.h"
+#include "Hash.h"
+#include "Log.h"
+#include "Platform.h"
+
+namespace fs = std::filesystem;
+
+namespace c_plus_eight {
+	BootCache::BootCache(const char* directory)
+	{
+		if (directory != NULL) {
+			this->directory = directory;
+		} // end if (directory != NULL)
+	}
+
+	// ROM images are read once per path (callers hold the lock)
+	const std::vector<uint8_t>* BootCache::read_rom(const char* rom_path)
+	{
+		auto it = this->roms.find(rom_path);
+		if (it != this->roms.end()) {
+			return &it->second;
+		} // end if (cached)
+
+		FILE* game;
+		fopen_s(&game, rom_path, "rb");
+
+		if (game == NULL) {
+			LOG_ERROR("Could not open file '{}'.", rom_path);
+			return NULL;
+		} // end if
+
+		std::vector<uint8_t> data(4096 - 512);
+		data.resize(fread(data.data(), 1, data.size(), game));
+		fclose(game);
+
+		return &(this->roms[rom_path] = std::move(data));
+	}
+
+	std::string BootCache::snapshot_path(const Key& key) const
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "/%016llx-%016llx-%u-%u-%02x-%016llx.c8ss",
+			(unsigned long long)std::get<0>(key), (unsigned long long)std::get<1>(key), std::get<2>(key),
+			std::get<3>(key), std::get<4>(key), (unsigned long long)std::get<5>(key));
+		return this->directory + name;
+	}
+
+	// Load the ROM and run it to the cached point, or restore that point from disk
+	std::unique_ptr<Chip8> BootCache::boot(const std::vector<uint8_t>& rom, const BootOptions& options, const Key& key)
+	{
+		std::unique_ptr<Chip8> emu = std::make_unique<Chip8>(std::get<1>(key));
+		emu->set_quirks(std::get<4>(key));
+		emu->load_game(rom.data(), rom.size());
+
+		std::string path = this->directory.empty() ? std::string() : this->snapshot_path(key);
+		if (!path.empty()) {
+			FILE* in;
+			fopen_s(&in, path.c_str(), "rb");
+			if (in != NULL) {
+				std::vector<uint8_t> blob(SAVE_STATE_SIZE);
+				size_t len = fread(blob.data(), 1, blob.size(), in);
+				fclose(in);
+				if (emu->load_state(blob.data(), len)) {
+					return emu;
+				}
+			} // end if (in != NULL)
+		} // end if (!path.empty())
+
+		if (options.intro != NULL) {
+			if (!play_movie(*emu, *options.intro)) {
+				return NULL;
+			}
+		}
+		else {
+			for (uint32_t i = 0; i < options.frames; i++) {
+				emu->run_frame(options.cycles_per_frame);
+			} // end for (i)
+		} // end if (intro != NULL)
+
+		if (!path.empty()) {
+			this->write_snapshot(*emu, path);
+		} // end if (!path.empty())
+
+		return emu;
+	}
+
+	/**
+	 * Save a booted machine under path. The state goes to a temporary file
+	 * first and is renamed into place, so other threads and processes sharing
+	 * the directory see either no snapshot or a whole one.
+	 */
+	void BootCache::write_snapshot(const Chip8& emu, const std::string& path) const
+	{
+		std::vector<uint8_t> blob(SAVE_STATE_SIZE);
+		emu.save_state(blob.data(), blob.size());
+
+		// unique per writer, as two of them may boot the same ROM at once
+		uint64_t nonce = hash64_key(std::hash<std::thread::id>()(std::this_thread::get_id()),
+			(uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%016llx.tmp", (unsigned long long)nonce);
+		std::string temp_path = path + suffix;
+
+		FILE* out;
+		fopen_s(&out, temp_path.c_str(), "wb");
+		if (out == NULL) {
+			LOG_WARN("Could not write boot snapshot '{}'.", path);
+			return;
+		} // end if (out == NULL)
+		bool ok = fwrite(blob.data(), 1, blob.size(), out) == blob.size();
+		ok = (fclose(out) == 0) && ok;
+
+		std::error_code error;
+		if (ok) {
+			fs::rename(temp_path, path, error);
+			ok = !error;
+		} // end if (ok)
+		if (!ok) {
+			LOG_WARN("Could not write boot snapshot '{}'.", path);
+			fs::remove(temp_path, error);
+		} // end if (!ok)
+	}
+
+	// Booted machine for a ROM, shared by every caller; clone it (or use spawn) to run it
+	const Chip8* BootCache::prototype(const char* rom_path, const BootOptions& options)
+	{
+		const std::vector<uint8_t>* rom;
+		Key key;
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+
+			rom = this->read_rom(rom_path);
+			if (rom == NULL) {
+				return NULL;
+			} // end if (rom == NULL)
+
+			if (options.intro != NULL) {
+				const MovieHeader& h = options.intro->get_header();
+				const std::vector<MovieRecord>& recs = options.intro->get_records();
+				key = Key(h.rom_hash, h.seed, h.frame_count, h.cycles_per_frame, h.quirks,
+					hash64(recs.data(), recs.size() * sizeof(MovieRecord)));
+			}
+			else {
+				key = Key(hash64(rom->data(), rom->size()), options.seed, options.frames, options.cycles_per_frame, options.quirks, 0);
+			} // end if (intro != NULL)
+
+			auto it = this->prototypes.find(key);
+			if (it != this->prototypes.end()) {
+				return it->second.get();
+			} // end if (cached)
+		}
+
+		// boot without the lock, so callers wanting other ROMs are not held up; ROM
+		// images are never dropped, so rom stays valid
+		std::unique_ptr<Chip8> emu = this->boot(*rom, options, key);
+		if (!emu) {
+			return NULL;
+		} // end if (!emu)
+
+		// settle the lazily computed hashes now, prototypes are read concurrently from here on
+		emu->state_hash();
+
+		// if another caller booted the same key meanwhile, everyone gets the first one in
+		std::lock_guard<std::mutex> guard(this->lock);
+		return this->prototypes.emplace(key, std::move(emu)).first->second.get();
+	}
+
+	std::unique_ptr<Chip8> BootCache::spawn(const char* rom_path, const BootOptions& options)
+	{
+		const Chip8* proto = this->prototype(rom_path, options);
+		return (proto != NULL) ? proto->clone() : NULL;
+	}
+
+	size_t BootCache::size()
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		return this->prototypes.size();
+	}
+}
@@ -0,0 +1,64 @@
+/**
+ * BootCache.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Chip8.h"
+#include "Movie.h"
+
+namespace c_plus_eight {
+	/* How to bring a freshly loaded ROM to the point that gets cached */
+	struct BootOptions {
+		uint64_t seed = 0;
+		uint8_t quirks = 0;
+		uint32_t frames = 0;                // frames to run before taking the snapshot
+		unsigned int cycles_per_frame = 10;
+
+		/* Input for the boot frames (e.g. to get past a title screen). If set,
+		   the movie's seed, quirks, cycles per frame and length are used instead */
+		const Movie* intro = NULL;
+	};
+
+	/**
+	 * Per-ROM cache of booted machines. The first request for a ROM and set of
+	 * options loads and runs it; every later one is a clone of that prototype,
+	 * sharing its memory pages copy-on-write, so thousands of instances can
+	 * start from the same point without re-reading the ROM or re-running its
+	 * boot code. With a directory, prototypes are also kept as save states
+	 * across runs. Safe to use from several threads.
+	 */
+	class BootCache
+	{
+	private:
+		/* rom hash, seed, frames, cycles per frame, quirks, intro hash */
+		typedef std::tuple<uint64_t, uint64_t, uint32_t, uint32_t, uint8_t, uint64_t> Key;
+
+		std::string directory;
+		std::mutex lock;
+		std::map<std::string, std::vector<uint8_t>> roms;
+		std::map<Key, std::unique_ptr<const Chip8>> prototypes;
+
+		const std::vector<uint8_t>* read_rom(const char* rom_path);
+		std::string snapshot_path(const Key& key) const;
+		std::unique_ptr<Chip8> boot(const std::vector<uint8_t>& rom, const BootOptions& options, const Key& key);
+		void write_snapshot(const Chip8& emu, const std::string& path) const;
+
+	public:
+		BootCache(const char* directory = NULL);
+
+		const Chip8* prototype(const char* rom_path, const BootOptions& options = BootOptions());
+		std::unique_ptr<Chip8> spawn(const char* rom_path, const BootOptions& options = BootOptions());
+
+		size_t size();
+	};
+}
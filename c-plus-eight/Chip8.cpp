@@ -4,17 +4,113 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "Chip8.h"
-#include "spdlog/spdlog.h"
+#include "Trace.h"
+#include "Log.h"
+#include "Platform.h"
 
 namespace c_plus_eight {
+	/* Data for system font */
+	static constexpr uint8_t fontset[80] = {
+		0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+		0x20, 0x60, 0x20, 0x20, 0x70, // 1
+		0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+		0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+		0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+		0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+		0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+		0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+		0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+		0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+		0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+		0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+		0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+		0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+		0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+		0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+	};
+
+	// Page holding the system font, shared by every machine until written
+	static MemoryPage* font_page()
+	{
+		static MemoryPage* page = [] {
+			MemoryPage* p = new MemoryPage();
+			memcpy(p->bytes, fontset, sizeof(fontset));
+			return p;
+		}();
+		return page;
+	}
+
+	// Page of zeroes, shared by every machine until written
+	static MemoryPage* zero_page()
+	{
+		static MemoryPage* page = new MemoryPage();
+		return page;
+	}
+
+	Chip8::Chip8(uint64_t rng_seed)
+	{
+		// memory starts out as the shared font page followed by shared zero pages
+		this->pages[0] = MemoryPage::acquire(font_page());
+		for (size_t i = 1; i < MEMORY_PAGES; i++) {
+			this->pages[i] = MemoryPage::acquire(zero_page());
+		}
+
+		this->seed(rng_seed);
+	}
+
+	Chip8::Chip8(const Chip8& other)
+		: Chip8Registers(other), opcode(other.opcode), update_screen(other.update_screen), rom_hash(other.rom_hash),
+		memory_hash(other.memory_hash), graphics_hash(other.graphics_hash), hash_valid(other.hash_valid)
+	{
+		for (size_t i = 0; i < MEMORY_PAGES; i++) {
+			this->pages[i] = MemoryPage::acquire(other.pages[i]);
+		}
+
+#ifdef MEASURE_LATENCY
+		this->input_probe = other.input_probe;
+#endif
+	}
+
+	Chip8& Chip8::operator=(const Chip8& other)
+	{
+		if (this != &other) {
+			static_cast<Chip8Registers&>(*this) = other;
+			this->opcode = other.opcode;
+			this->update_screen = other.update_screen;
+			this->rom_hash = other.rom_hash;
+			this->memory_hash = other.memory_hash;
+			this->graphics_hash = other.graphics_hash;
+			this->hash_valid = other.hash_valid;
+			for (size_t i = 0; i < MEMORY_PAGES; i++) {
+				MemoryPage* old = this->pages[i];
+				this->pages[i] = MemoryPage::acquire(other.pages[i]);
+				MemoryPage::release(old);
+			}
+
+#ifdef MEASURE_LATENCY
+			this->input_probe = other.input_probe;
+#endif
+		}
+		return *this;
+	}
+
+	Chip8::~Chip8()
+	{
+		for (MemoryPage* p : this->pages) {
+			MemoryPage::release(p);
+		}
+	}
+
 	// Clear display
 	void Chip8::op_cls()
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("CLS");
+		LOG_DEBUG("CLS");
 #endif
 		this->graphics.fill(0);
+		this->graphics_hash = 0;
 		this->update_screen = true;
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_cls()
@@ -23,13 +119,15 @@ namespace c_plus_eight {
 	void Chip8::op_ret()
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("RET");
+		LOG_DEBUG("RET");
 #endif
-		// retrieve previous address from top of stack
-		this->pc = this->stack.top();
+		if (this->sp == 0) {
+			LOG_ERROR("Stack underflow at {}", this->pc);
+			throw stack_error();
+		} // end if (sp == 0)
 
-		// "decrement stack pointer" by popping top address off of the stack
-		this->stack.pop();
+		// decrement stack pointer and retrieve previous address from top of stack
+		this->pc = this->stack[--this->sp];
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_ret()
 
@@ -37,7 +135,7 @@ namespace c_plus_eight {
 	void Chip8::op_jp_nnn(uint16_t nnn)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("JP {}", nnn);
+		LOG_DEBUG("JP {}", nnn);
 #endif
 		this->pc = nnn;
 	} // end Chip8::op_jp_nnn()
@@ -46,11 +144,16 @@ namespace c_plus_eight {
 	void Chip8::op_call_nnn(uint16_t nnn)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("CALL {}", nnn);
+		LOG_DEBUG("CALL {}", nnn);
 #endif
+		if (this->sp == this->stack.size()) {
+			LOG_ERROR("Stack overflow at {}", this->pc);
+			throw stack_error();
+		} // end if (sp == stack.size())
+
 		// place program counter at the top of the stack
-		// and simultaneously "increment the stack pointer"
-		this->stack.push(this->pc);
+		// and increment the stack pointer
+		this->stack[this->sp++] = this->pc;
 
 		// set program counter to address
 		this->pc = nnn;
@@ -60,7 +163,7 @@ namespace c_plus_eight {
 	void Chip8::op_se_x_kk(uint8_t x, uint8_t kk)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SE V{}, {}", x, kk);
+		LOG_DEBUG("SE V{}, {}", x, kk);
 #endif
 		if (this->V[x] == kk) {
 			NEXT_INSTRUCTION;
@@ -72,7 +175,7 @@ namespace c_plus_eight {
 	void Chip8::op_sne_x_kk(uint8_t x, uint8_t kk)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SNE V{}, {}", x, kk);
+		LOG_DEBUG("SNE V{}, {}", x, kk);
 #endif
 		if (this->V[x] != kk) {
 			NEXT_INSTRUCTION;
@@ -84,7 +187,7 @@ namespace c_plus_eight {
 	void Chip8::op_se_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SE V{}, V{}", x, y);
+		LOG_DEBUG("SE V{}, V{}", x, y);
 #endif
 		if (this->V[x] == this->V[y]) {
 			NEXT_INSTRUCTION;
@@ -96,7 +199,7 @@ namespace c_plus_eight {
 	void Chip8::op_ld_x_kk(uint8_t x, uint8_t kk)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD V{}, {}", x, kk);
+		LOG_DEBUG("LD V{}, {}", x, kk);
 #endif
 		this->V[x] = kk;
 		NEXT_INSTRUCTION;
@@ -106,7 +209,7 @@ namespace c_plus_eight {
 	void Chip8::op_add_x_kk(uint8_t x, uint8_t kk)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("ADD V{}, {}", x, kk);
+		LOG_DEBUG("ADD V{}, {}", x, kk);
 #endif
 		this->V[x] += kk;
 		NEXT_INSTRUCTION;
@@ -116,7 +219,7 @@ namespace c_plus_eight {
 	void Chip8::op_ld_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD V{}, V{}", x, y);
+		LOG_DEBUG("LD V{}, V{}", x, y);
 #endif
 		this->V[x] = this->V[y];
 		NEXT_INSTRUCTION;
@@ -126,9 +229,12 @@ namespace c_plus_eight {
 	void Chip8::op_or_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("OR V{}, V{}", x, y);
+		LOG_DEBUG("OR V{}, V{}", x, y);
 #endif
 		this->V[x] |= this->V[y];
+		if (this->quirks & QUIRK_VF_RESET) {
+			this->V[0xF] = 0;
+		} // end if (QUIRK_VF_RESET)
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_or_x_y()
 
@@ -136,9 +242,12 @@ namespace c_plus_eight {
 	void Chip8::op_and_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("AND V{}, V{}", x, y);
+		LOG_DEBUG("AND V{}, V{}", x, y);
 #endif
 		this->V[x] &= this->V[y];
+		if (this->quirks & QUIRK_VF_RESET) {
+			this->V[0xF] = 0;
+		} // end if (QUIRK_VF_RESET)
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_and_x_y()
 
@@ -146,9 +255,12 @@ namespace c_plus_eight {
 	void Chip8::op_xor_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("XOR V{}, V{}", x, y);
+		LOG_DEBUG("XOR V{}, V{}", x, y);
 #endif
 		this->V[x] ^= this->V[y];
+		if (this->quirks & QUIRK_VF_RESET) {
+			this->V[0xF] = 0;
+		} // end if (QUIRK_VF_RESET)
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_xor_x_y()
 
@@ -156,7 +268,7 @@ namespace c_plus_eight {
 	void Chip8::op_add_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("ADD V{}, V{}", x, y);
+		LOG_DEBUG("ADD V{}, V{}", x, y);
 #endif
 		if (this->V[y] > (0xFF - this->V[x])) {
 			this->V[0xF] = 1; // carry
@@ -173,7 +285,7 @@ namespace c_plus_eight {
 	void Chip8::op_sub_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SUB V{}, V{}", x, y);
+		LOG_DEBUG("SUB V{}, V{}", x, y);
 #endif
 		if (this->V[x] > this->V[y]) {
 			this->V[0xF] = 1; // NOT borrow
@@ -187,11 +299,15 @@ namespace c_plus_eight {
 	} // end Chip8::op_sub_x_y()
 
 	// Set Vx = Vx SHR 1
-	void Chip8::op_shr_x(uint8_t x)
+	void Chip8::op_shr_x(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SHR V{}, (, V{})", x, y);
+		LOG_DEBUG("SHR V{}, (, V{})", x, y);
 #endif
+		if (this->quirks & QUIRK_SHIFT_VY) {
+			this->V[x] = this->V[y];
+		} // end if (QUIRK_SHIFT_VY)
+
 		this->V[0xF] = V[x] & 0x1;
 		this->V[x] >>= 1;
 		NEXT_INSTRUCTION;
@@ -201,7 +317,7 @@ namespace c_plus_eight {
 	void Chip8::op_subn_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SUBN V{}, V{}", x, y);
+		LOG_DEBUG("SUBN V{}, V{}", x, y);
 #endif
 		if (this->V[y] > this->V[x]) {
 			this->V[0xF] = 1; // NOT borrow
@@ -215,11 +331,15 @@ namespace c_plus_eight {
 	} // end Chip8::op_subn_x_y()
 
 	// Set Vx = Vx SHL 1
-	void Chip8::op_shl_x(uint8_t x)
+	void Chip8::op_shl_x(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SHL V{} (, V{})", x, y);
+		LOG_DEBUG("SHL V{} (, V{})", x, y);
 #endif
+		if (this->quirks & QUIRK_SHIFT_VY) {
+			this->V[x] = this->V[y];
+		} // end if (QUIRK_SHIFT_VY)
+
 		this->V[0xF] = (this->V[x] & 0x80) >> 7;
 		this->V[x] <<= 1;
 		NEXT_INSTRUCTION;
@@ -229,7 +349,7 @@ namespace c_plus_eight {
 	void Chip8::op_sne_x_y(uint8_t x, uint8_t y)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SNE V{}, V{}", x, y);
+		LOG_DEBUG("SNE V{}, V{}", x, y);
 #endif
 		if (this->V[x] != this->V[y]) {
 			NEXT_INSTRUCTION;
@@ -242,28 +362,29 @@ namespace c_plus_eight {
 	void Chip8::op_ld_I_nnn(uint16_t nnn)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD I, {}", nnn);
+		LOG_DEBUG("LD I, {}", nnn);
 #endif
 		this->I = nnn;
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_ld_I_nnn()
 
-	// Jump to location nnn + V0
-	void Chip8::op_jp_0_nnn(uint16_t nnn)
+	// Jump to location nnn + V0 (or xnn + Vx with QUIRK_JUMP_VX)
+	void Chip8::op_jp_0_nnn(uint8_t x, uint16_t nnn)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("JP V{}, {}", this->V[0], nnn);
+		LOG_DEBUG("JP V{}, {}", this->V[0], nnn);
 #endif
-		this->pc = nnn + this->V[0];
+		uint8_t offset_reg = (this->quirks & QUIRK_JUMP_VX) ? x : 0;
+		this->pc = nnn + this->V[offset_reg];
 	} // end Chip8::op_jp_0_nnn()
 
 	// Set Vx = random byte AND kk
 	void Chip8::op_rnd_x_kk(uint8_t x, uint8_t kk)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("RND V{}, {}", x, kk);
+		LOG_DEBUG("RND V{}, {}", x, kk);
 #endif
-		this->V[x] = (rd() % 0xFF) & kk;
+		this->V[x] = (this->next_random() >> 24) & kk;
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_rnd_x_kk()
 
@@ -271,52 +392,73 @@ namespace c_plus_eight {
 	void Chip8::op_drw_x_y_n(uint8_t x, uint8_t y, uint8_t n)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("DRW V{}, V{}, {}", x, y, n);
+		LOG_DEBUG("DRW V{}, V{}, {}", x, y, n);
+#endif
+		this->V[0xF] = this->draw_sprite(x, y, this->I, n) ? 1 : 0;
+		NEXT_INSTRUCTION;
+	} // end Chip8::op_drw_x_y_n()
+
+	// XOR a sprite onto the screen, wrapping around the edges
+	bool Chip8::draw_sprite(uint8_t x, uint8_t y, uint16_t addr, uint8_t n)
+	{
+		bool collision = false;
+#ifdef MEASURE_LATENCY
+		bool changed = false;
 #endif
-		// set collision flag to 0
-		this->V[0xF] = 0;
 
-		// render sprite at memory location I
+		// render sprite at memory location addr, a row at a time
+		uint8_t shift = x % SCREEN_COLS;
 		for (uint8_t byte_index = 0; byte_index < n; byte_index++) {
-			uint8_t byte = this->memory[I + byte_index];
-
-			for (uint8_t bit_index = 0; bit_index < 8; bit_index++) {
-				uint8_t bit = (byte >> bit_index) & 0x1;
-				
-				// calculate current row and column as it would appear in OpenGL
-				uint8_t cur_row = SCREEN_ROWS - (((y + byte_index) % SCREEN_ROWS) + 1);
-				uint8_t cur_col = (x + (7 - bit_index)) % SCREEN_COLS;
-
-				// get pointer to current pixel
-				uint8_t* pixelp = &this->graphics[(cur_row * SCREEN_COLS) + cur_col];
-
-				if (bit) {
-					// detect collision
-					if (*pixelp == 0xFF) {
-						this->V[0xF] = 1;
-					} // end if (*pixelp == 0xFF)
-
-					// toggle current pixel (use 0xFF for full luminance)
-					*pixelp ^= 0xFF;
-				} // end if (bit)
-
-				pixelp = NULL;
-			} // end for (bit_index)
+			// place the sprite byte at column x, wrapping around the right edge
+			uint64_t bits = (uint64_t)this->read_memory(addr + byte_index) << 56;
+			if (shift != 0) {
+				bits = (bits >> shift) | (bits << (64 - shift));
+			} // end if (shift != 0)
+
+			if (bits == 0) {
+				continue;
+			} // end if (bits == 0)
+
+			size_t cur_row = (y + byte_index) % SCREEN_ROWS;
+			uint64_t& row = this->graphics[cur_row];
+
+			// detect collision
+			if (row & bits) {
+				collision = true;
+			} // end if (row & bits)
+
+			if (this->hash_valid) {
+				this->graphics_hash ^= row_key(cur_row, row) ^ row_key(cur_row, row ^ bits);
+			} // end if (hash_valid)
+
+			// toggle the sprite's pixels
+			row ^= bits;
+#ifdef MEASURE_LATENCY
+			changed = true;
+#endif
 		} // end for (byte_index)
 
-		NEXT_INSTRUCTION;
+#ifdef MEASURE_LATENCY
+		if (changed) {
+			this->input_probe.drawn = this->input_probe.read;
+		} // end if (changed)
+#endif
 
 		// update OpenGL pixel buffer
 		this->update_screen = true;
-	} // end Chip8::op_drw_x_y_n()
+		return collision;
+	} // end Chip8::draw_sprite()
 
 	// Skip next instruction if key with the value of Vx is pressed
 	void Chip8::op_skp_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SKP V{}", x);
+		LOG_DEBUG("SKP V{}", x);
+#endif
+#ifdef MEASURE_LATENCY
+		this->input_probe.read = this->input_probe.applied;
 #endif
-		if (this->key[this->V[x]]) {
+		if ((this->keys >> (this->V[x] & 0xF)) & 0x1) {
 			NEXT_INSTRUCTION;
 		}
 	} // end Chip8::op_skp_x()
@@ -325,9 +467,12 @@ namespace c_plus_eight {
 	void Chip8::op_sknp_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("SKNP V{}", x);
+		LOG_DEBUG("SKNP V{}", x);
 #endif
-		if (!this->key[this->V[x]]) {
+#ifdef MEASURE_LATENCY
+		this->input_probe.read = this->input_probe.applied;
+#endif
+		if (!((this->keys >> (this->V[x] & 0xF)) & 0x1)) {
 			NEXT_INSTRUCTION;
 		}
 	} // end Chip8::op_sknp_x()
@@ -336,7 +481,7 @@ namespace c_plus_eight {
 	void Chip8::op_ld_x_DT(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD V{}, {}", x, this->delay_timer);
+		LOG_DEBUG("LD V{}, {}", x, this->delay_timer);
 #endif
 		this->V[x] = this->delay_timer;
 		NEXT_INSTRUCTION;
@@ -346,22 +491,29 @@ namespace c_plus_eight {
 	void Chip8::op_ld_x_K(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD V{}, K", x);
+		LOG_DEBUG("LD V{}, K", x);
+#endif
+#ifdef MEASURE_LATENCY
+		this->input_probe.read = this->input_probe.applied;
 #endif
 		for (int i = 0; i < 16; i++) {
-			if (this->key[i]) {
+			if ((this->keys >> i) & 0x1) {
 				this->V[x] = i;
 				NEXT_INSTRUCTION;
-				break;
+				return;
 			}
 		}
+
+		// no key is down, so halt until key_press() delivers one
+		this->waiting_for_key = true;
+		this->key_wait_reg = x;
 	} // end Chip8::op_ld_x_K()
 
 	// Set delay timer = Vx
 	void Chip8::op_ld_DT_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD DT, V{}", x);
+		LOG_DEBUG("LD DT, V{}", x);
 #endif
 		this->delay_timer = this->V[x];
 		NEXT_INSTRUCTION;
@@ -371,9 +523,15 @@ namespace c_plus_eight {
 	void Chip8::op_ld_ST_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD ST, V{}", x);
+		LOG_DEBUG("LD ST, V{}", x);
 #endif
+		bool was_on = this->sound_timer > 0;
 		this->sound_timer = this->V[x];
+
+		// notify the audio thread when the beeper is gated on or off
+		if (this->sound_events != NULL && was_on != (this->sound_timer > 0)) {
+			this->sound_events->push({ this->cycles, !was_on });
+		} // end if (sound_events != NULL)
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_ld_ST_x()
 
@@ -381,7 +539,7 @@ namespace c_plus_eight {
 	void Chip8::op_add_I_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("ADD I, V{}", x);
+		LOG_DEBUG("ADD I, V{}", x);
 #endif
 		this->I += this->V[x];
 		NEXT_INSTRUCTION;
@@ -391,7 +549,7 @@ namespace c_plus_eight {
 	void Chip8::op_ld_F_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD F, {}", x);
+		LOG_DEBUG("LD F, {}", x);
 #endif
 		this->I = FONTSET_BYTES_PER_CHAR * this->V[x];
 		NEXT_INSTRUCTION;
@@ -401,11 +559,11 @@ namespace c_plus_eight {
 	void Chip8::op_ld_B_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD B, V{}", x);
+		LOG_DEBUG("LD B, V{}", x);
 #endif
-		this->memory[this->I] = (this->V[x] / 100);
-		this->memory[this->I + 1] = (this->V[x] / 10) % 10;
-		this->memory[this->I + 2] = (this->V[x] % 10);
+		this->write_memory(this->I, this->V[x] / 100);
+		this->write_memory(this->I + 1, (this->V[x] / 10) % 10);
+		this->write_memory(this->I + 2, this->V[x] % 10);
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_ld_B_x()
 
@@ -413,14 +571,16 @@ namespace c_plus_eight {
 	void Chip8::op_ld_intoI_x(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD [I], V{}", x);
+		LOG_DEBUG("LD [I], V{}", x);
 #endif
-		std::copy(this->V.begin(),
-			std::next(this->V.begin(), x + 1),
-			std::next(this->memory.begin(), I));
+		for (uint8_t i = 0; i <= x; i++) {
+			this->write_memory(this->I + i, this->V[i]);
+		} // end for (i)
 
 		// advance I by the number of bytes stored
-		this->I += x + 1;
+		if (!(this->quirks & QUIRK_LOAD_STORE_I)) {
+			this->I += x + 1;
+		} // end if (!QUIRK_LOAD_STORE_I)
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_ld_intoI_x()
 
@@ -428,17 +588,40 @@ namespace c_plus_eight {
 	void Chip8::op_ld_x_fromI(uint8_t x)
 	{
 #ifdef PRINT_OPCODES
-		spdlog::get("logger")->debug("LD V{}, [I]", x);
+		LOG_DEBUG("LD V{}, [I]", x);
 #endif
-		std::copy(std::next(this->memory.begin(), I),
-			std::next(this->memory.begin(), I + x + 1),
-			this->V.begin());
+		for (uint8_t i = 0; i <= x; i++) {
+			this->V[i] = this->read_memory(this->I + i);
+		} // end for (i)
 
 		// advance I by the number of bytes read
-		this->I += x + 1;
+		if (!(this->quirks & QUIRK_LOAD_STORE_I)) {
+			this->I += x + 1;
+		} // end if (!QUIRK_LOAD_STORE_I)
 		NEXT_INSTRUCTION;
 	} // end Chip8::op_ld_x_fromI()
 
+	// Advance the PCG32 generator (XSH RR output)
+	uint32_t Chip8::next_random()
+	{
+		uint64_t old = this->rng_state;
+		this->rng_state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+
+		uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rot = (uint32_t)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	} // end Chip8::next_random()
+
+	// Restart the random number generator from the given seed
+	void Chip8::seed(uint64_t rng_seed)
+	{
+		this->rng_seed = rng_seed;
+		this->rng_state = 0;
+		this->next_random();
+		this->rng_state += rng_seed;
+		this->next_random();
+	} // end Chip8::seed()
+
 	// Load game data from given file and store in system memory
 	bool Chip8::load_game(const char* file_path)
 	{
@@ -446,34 +629,89 @@ namespace c_plus_eight {
 		fopen_s(&game, file_path, "rb");
 
 		if (game == NULL) {
-			spdlog::get("logger")->error("Could not open file '{}'.", file_path);
+			LOG_ERROR("Could not open file '{}'.", file_path);
 			return false;
 		} // end if
 
 		// read in game data and store in memory at 0x200
-		fread(&this->memory[0x200], 1, 4096 - 512, game);
-
+		std::array<uint8_t, 4096 - 512> data;
+		size_t len = fread(data.data(), 1, data.size(), game);
 		fclose(game);
+
+		return this->load_game(data.data(), len);
+	} // end Chip8::load_game()
+
+	// Store a ROM image already in memory at 0x200 (anything past the end of memory is dropped)
+	bool Chip8::load_game(const uint8_t* data, size_t len)
+	{
+		len = std::min<size_t>(len, 4096 - 512);
+		this->load_memory(0x200, data, len);
+		this->rom_hash = hash64(data, len);
 		return true;
 	} // end Chip8::load_game()
 
 	// Set given key as "pressed"
 	void Chip8::key_press(uint8_t key_val)
 	{
-		this->key[key_val] = 1;
+		this->keys |= (1 << key_val);
+#ifdef MEASURE_LATENCY
+		++this->input_probe.applied;
+#endif
+
+		// complete a pending "LD Vx, K"
+		if (this->waiting_for_key) {
+#ifdef MEASURE_LATENCY
+			this->input_probe.read = this->input_probe.applied;
+#endif
+			this->V[this->key_wait_reg] = key_val;
+			this->waiting_for_key = false;
+			NEXT_INSTRUCTION;
+		} // end if (waiting_for_key)
 	} // end Chip8::key_press()
 
 	// Set given key as "released"
 	void Chip8::key_release(uint8_t key_val)
 	{
-		this->key[key_val] = 0;
+		this->keys &= ~(1 << key_val);
+#ifdef MEASURE_LATENCY
+		++this->input_probe.applied;
+#endif
 	} // end Chip8::key_release()
 
-	// Perform current operation and update screen if necessary
+	// Press and release keys until the keypad matches the given bitset (lowest key first)
+	void Chip8::set_keys(uint16_t state)
+	{
+		uint16_t changed = this->keys ^ state;
+		for (uint8_t key = 0; changed != 0; key++, changed >>= 1) {
+			if ((changed & 1) == 0) {
+				continue;
+			} // end if ((changed & 1) == 0)
+
+			if ((state >> key) & 1) {
+				this->key_press(key);
+			}
+			else {
+				this->key_release(key);
+			} // end if ((state >> key) & 1)
+		} // end for (key)
+	} // end Chip8::set_keys()
+
+	// Perform current operation
 	void Chip8::emulate_cycle()
 	{
+		// nothing to do while halted on "LD Vx, K"
+		if (this->waiting_for_key) {
+			return;
+		} // end if (waiting_for_key)
+
+		++this->cycles;
+
 		// retrieve opcode from current memory position
-		this->opcode = (this->memory[this->pc] << 8) | this->memory[this->pc + 1];
+		this->opcode = (this->read_memory(this->pc) << 8) | this->read_memory(this->pc + 1);
+
+		if (this->trace != NULL) {
+			this->trace->push({ this->cycles, this->pc, this->opcode, this->I, this->sp, this->V[0xF] });
+		} // end if (trace != NULL)
 
 		// dissect opcode
 		uint8_t x = OPCODE_X(this->opcode);
@@ -494,7 +732,7 @@ namespace c_plus_eight {
 				this->op_ret();
 				break;
 			default:
-				spdlog::get("logger")->error("Unknown opcode: {}", this->opcode);
+				LOG_ERROR("Unknown opcode: {}", this->opcode);
 				throw unknown_opcode_error();
 			} // end switch (kk)
 			break;
@@ -540,16 +778,16 @@ namespace c_plus_eight {
 				this->op_sub_x_y(x, y);
 				break;
 			case 0x6:
-				this->op_shr_x(x);
+				this->op_shr_x(x, y);
 				break;
 			case 0x7:
 				this->op_subn_x_y(x, y);
 				break;
 			case 0xE:
-				this->op_shl_x(x);
+				this->op_shl_x(x, y);
 				break;
 			default:
-				spdlog::get("logger")->error("Unknown opcode: {}", this->opcode);
+				LOG_ERROR("Unknown opcode: {}", this->opcode);
 				throw unknown_opcode_error();
 			} // end switch (n)
 			break;
@@ -560,7 +798,7 @@ namespace c_plus_eight {
 			this->op_ld_I_nnn(nnn);
 			break;
 		case 0xB000:
-			this->op_jp_0_nnn(nnn);
+			this->op_jp_0_nnn(x, nnn);
 			break;
 		case 0xC000:
 			this->op_rnd_x_kk(x, kk);
@@ -577,7 +815,7 @@ namespace c_plus_eight {
 				this->op_sknp_x(x);
 				break;
 			default:
-				spdlog::get("logger")->error("Unknown opcode: {}", this->opcode);
+				LOG_ERROR("Unknown opcode: {}", this->opcode);
 				throw unknown_opcode_error();
 			} // end switch (kk)
 			NEXT_INSTRUCTION;
@@ -612,33 +850,301 @@ namespace c_plus_eight {
 				this->op_ld_x_fromI(x);
 				break;
 			default:
-				spdlog::get("logger")->error("Unknown opcode: {}", this->opcode);
+				LOG_ERROR("Unknown opcode: {}", this->opcode);
 				throw unknown_opcode_error();
 			} // end switch (kk)
 			break;
 		default:
-			spdlog::get("logger")->error("Unknown opcode: {}", this->opcode);
+			LOG_ERROR("Unknown opcode: {}", this->opcode);
 			throw unknown_opcode_error();
 		} // end switch (opcode & 0xF000)
-
-		if (this->update_screen) {
-			r->draw(&this->graphics);
-			this->update_screen = false;
-		} // end if (update_screen)
 	} // end Chip8::emulate_cycle()
 
+	// Execute up to the given number of operations, passing the rest of the time halted if need be
+	void Chip8::run_cycles(unsigned int cycles)
+	{
+		for (unsigned int i = 0; i < cycles; i++) {
+			if (this->waiting_for_key) {
+				// emulated time keeps passing while halted
+				this->cycles += cycles - i;
+				break;
+			} // end if (waiting_for_key)
+
+			this->emulate_cycle();
+		} // end for (i)
+	} // end Chip8::run_cycles()
+
+	// Execute up to the given number of operations, then decrement system timers
+	void Chip8::run_frame(unsigned int cycles)
+	{
+		this->run_cycles(cycles);
+		this->tick();
+	} // end Chip8::run_frame()
+
 	// Decrement system timers
 	void Chip8::tick()
 	{
+		++this->frames;
+
 		if (this->delay_timer > 0) {
 			--this->delay_timer;
 		} // end if (delay_timer > 0)
 
 		if (this->sound_timer > 0) {
 			--sound_timer;
-			if (this->sound_timer == 0) {
-				spdlog::get("logger")->info("Sound timer reached 0.");
+			if (this->sound_timer == 0 && this->sound_events != NULL) {
+				this->sound_events->push({ this->cycles, false });
 			} // end if (sound_timer == 0)
 		} // end if (sound_timer > 0)
 	} // end Chip8::tick()
+
+	/**
+	 * Find the "LD Vx, DT / SE Vx, 0 / JP back" loop that ROMs spin in while
+	 * the delay timer runs down, if pc is inside one.
+	 */
+	bool Chip8::find_delay_loop(uint16_t& head) const
+	{
+		for (uint16_t offset = 0; offset <= 4; offset += 2) {
+			uint16_t h = this->pc - offset;
+			uint16_t load = (this->read_memory(h) << 8) | this->read_memory(h + 1);
+			uint16_t test = (this->read_memory(h + 2) << 8) | this->read_memory(h + 3);
+			uint16_t jump = (this->read_memory(h + 4) << 8) | this->read_memory(h + 5);
+			uint8_t x = OPCODE_X(load);
+			if ((load & 0xF0FF) != 0xF007 || test != (0x3000 | (x << 8)) || jump != (0x1000 | h)) {
+				continue;
+			} // end if (not a delay loop)
+
+			// entered at the SE with Vx already 0, it falls straight out
+			if (offset == 2 && this->V[x] == 0) {
+				return false;
+			} // end if (offset == 2)
+			head = h;
+			return true;
+		} // end for (offset)
+		return false;
+	} // end Chip8::find_delay_loop()
+
+	// Frames of run_frame(cycles) the machine will spend spinning on the delay timer (0 if it is not)
+	uint8_t Chip8::delay_wait_frames(unsigned int cycles) const
+	{
+		uint16_t head;
+		if (this->waiting_for_key || this->delay_timer == 0 || cycles < 3 || !this->find_delay_loop(head)) {
+			return 0;
+		} // end if (not spinning)
+		return this->delay_timer;
+	} // end Chip8::delay_wait_frames()
+
+	/**
+	 * Same as count calls to run_frame(cycles), in constant time when nothing
+	 * but time passes in them: halted on "LD Vx, K", or spinning for at most
+	 * delay_wait_frames(cycles) frames. Otherwise the frames are run. Skipped
+	 * instructions are not traced.
+	 */
+	void Chip8::skip_frames(uint32_t count, unsigned int cycles)
+	{
+		uint16_t head = 0;
+		bool halted = this->waiting_for_key;
+		if (!halted && (count > this->delay_wait_frames(cycles) || !this->find_delay_loop(head))) {
+			for (uint32_t i = 0; i < count; i++) {
+				this->run_frame(cycles);
+			} // end for (i)
+			return;
+		} // end if (not idle)
+		if (count == 0) {
+			return;
+		} // end if (count == 0)
+
+		uint64_t executed = (uint64_t)count * cycles;
+		if (!halted) {
+			// the loop is 3 instructions; the last LD Vx, DT ran in the last frame, before its tick
+			uint64_t position = (uint16_t)(this->pc - head) / 2;
+			uint16_t last = head + (uint16_t)(2 * ((position + executed - 1) % 3));
+			this->pc = head + (uint16_t)(2 * ((position + executed) % 3));
+			this->opcode = (this->read_memory(last) << 8) | this->read_memory(last + 1);
+			this->V[this->read_memory(head) & 0xF] = (uint8_t)(this->delay_timer - (count - 1));
+		} // end if (!halted)
+
+		uint64_t start = this->cycles;
+		this->cycles += executed;
+		this->frames += count;
+		this->delay_timer = (this->delay_timer > count) ? (uint8_t)(this->delay_timer - count) : 0;
+
+		if (this->sound_timer > 0) {
+			if (this->sound_timer <= count) {
+				if (this->sound_events != NULL) {
+					this->sound_events->push({ start + (uint64_t)this->sound_timer * cycles, false });
+				} // end if (sound_events != NULL)
+				this->sound_timer = 0;
+			}
+			else {
+				this->sound_timer -= (uint8_t)count;
+			} // end if (sound_timer <= count)
+		} // end if (sound_timer > 0)
+	} // end Chip8::skip_frames()
+
+	// Hash of the registers and pixel buffer, for comparing runs frame by frame
+	uint64_t Chip8::frame_hash() const
+	{
+		return hash64(static_cast<const Chip8Registers*>(this), sizeof(Chip8Registers));
+	} // end Chip8::frame_hash()
+
+	/**
+	 * Hash of everything that decides how the machine runs from here on: memory,
+	 * pixels, stack, registers, timers, keypad, halt state, quirks and RNG. Time
+	 * (cycles, frames) is left out, so the same state reached by different
+	 * input paths hashes the same. Memory and pixels are hashed incrementally
+	 * by their writes after the first call; the small register file is hashed
+	 * here.
+	 */
+	uint64_t Chip8::state_hash() const
+	{
+		if (!this->hash_valid) {
+			this->memory_hash = 0;
+			for (size_t i = 0; i < MEMORY_PAGES * MEMORY_PAGE_SIZE; i++) {
+				this->memory_hash ^= memory_key((uint16_t)i, this->read_memory((uint16_t)i));
+			} // end for (i)
+
+			this->graphics_hash = 0;
+			for (size_t row = 0; row < SCREEN_ROWS; row++) {
+				this->graphics_hash ^= row_key(row, this->graphics[row]);
+			} // end for (row)
+
+			this->hash_valid = true;
+		} // end if (!hash_valid)
+
+		// V through quirks is one contiguous, padding-free block
+		const uint8_t* regs = reinterpret_cast<const uint8_t*>(static_cast<const Chip8Registers*>(this));
+		uint64_t h = hash64(regs, offsetof(Chip8Registers, frames), this->rng_state);
+
+		// only the live return addresses; a RET leaves its entry behind but nothing reads it
+		// again before a CALL overwrites it
+		h = hash64(this->stack.data(), this->sp * sizeof(uint16_t), h);
+		return h ^ this->memory_hash ^ this->graphics_hash;
+	} // end Chip8::state_hash()
+
+	// Check whether the pixel buffer changed since the last call
+	bool Chip8::consume_screen_update()
+	{
+		bool updated = this->update_screen;
+		this->update_screen = false;
+		return updated;
+	} // end Chip8::consume_screen_update()
+
+	// Get a private copy of the page holding addr, copying it if it is shared
+	uint8_t* Chip8::page_for_write(uint16_t addr)
+	{
+		MemoryPage*& page = this->pages[(addr >> 8) & 0xF];
+		if (page->is_shared()) {
+			MemoryPage* spare = (this->page_pool != NULL) ? &this->page_pool[(addr >> 8) & 0xF] : NULL;
+			MemoryPage* copy = NULL;
+			if (spare != NULL && spare->is_free()) {
+				spare->refs.store(1, std::memory_order_relaxed);
+				copy = spare;
+			}
+			else {
+				copy = new MemoryPage();
+			} // end if (spare is free)
+			memcpy(copy->bytes, page->bytes, MEMORY_PAGE_SIZE);
+			MemoryPage::release(page);
+			page = copy;
+		} // end if (is_shared)
+
+		return page->bytes;
+	} // end Chip8::page_for_write()
+
+	// Copy a block of data into memory
+	void Chip8::load_memory(uint16_t addr, const uint8_t* data, size_t len)
+	{
+		for (size_t i = 0; i < len; i++) {
+			this->write_memory((uint16_t)(addr + i), data[i]);
+		} // end for (i)
+	} // end Chip8::load_memory()
+
+	// Replace all of memory, leaving pages that already match shared
+	void Chip8::restore_memory(const uint8_t* memory)
+	{
+		// state_hash() starts over from the restored state
+		this->hash_valid = false;
+
+		for (size_t i = 0; i < MEMORY_PAGES; i++) {
+			const uint8_t* src = memory + (i * MEMORY_PAGE_SIZE);
+			if (memcmp(this->pages[i]->bytes, src, MEMORY_PAGE_SIZE) != 0) {
+				memcpy(this->page_for_write((uint16_t)(i * MEMORY_PAGE_SIZE)), src, MEMORY_PAGE_SIZE);
+			} // end if (memcmp)
+		} // end for (i)
+	} // end Chip8::restore_memory()
+
+	// Copy the machine state out of the emulator
+	void Chip8::save_state(Chip8State& out) const
+	{
+		for (size_t i = 0; i < MEMORY_PAGES; i++) {
+			memcpy(&out.memory[i * MEMORY_PAGE_SIZE], this->pages[i]->bytes, MEMORY_PAGE_SIZE);
+		} // end for (i)
+
+		out.regs = *this;
+	} // end Chip8::save_state()
+
+	// Replace the machine state, the restored pixel buffer always needs a redraw
+	void Chip8::load_state(const Chip8State& in)
+	{
+		this->restore_memory(in.memory.data());
+		static_cast<Chip8Registers&>(*this) = in.regs;
+		this->update_screen = true;
+	} // end Chip8::load_state()
+
+	// Serialize the machine state into buf, returns the number of bytes written (0 if buf is too small)
+	size_t Chip8::save_state(uint8_t* buf, size_t len) const
+	{
+		if (len < SAVE_STATE_SIZE) {
+			return 0;
+		} // end if (len < SAVE_STATE_SIZE)
+
+		SaveStateHeader header = {};
+		memcpy(header.magic, SAVE_STATE_MAGIC, sizeof(header.magic));
+		header.version = SAVE_STATE_VERSION;
+		header.state_size = sizeof(Chip8State);
+		memcpy(buf, &header, sizeof(header));
+
+		uint8_t* state = buf + sizeof(header);
+		for (size_t i = 0; i < MEMORY_PAGES; i++) {
+			memcpy(state + offsetof(Chip8State, memory) + (i * MEMORY_PAGE_SIZE), this->pages[i]->bytes, MEMORY_PAGE_SIZE);
+		} // end for (i)
+		memcpy(state + offsetof(Chip8State, regs), static_cast<const Chip8Registers*>(this), sizeof(Chip8Registers));
+		return SAVE_STATE_SIZE;
+	} // end Chip8::save_state()
+
+	// Restore the machine state from a buffer written by save_state()
+	bool Chip8::load_state(const uint8_t* buf, size_t len)
+	{
+		SaveStateHeader header;
+		if (len < sizeof(header)) {
+			LOG_ERROR("Save state is truncated ({} bytes).", len);
+			return false;
+		} // end if (len < sizeof(header))
+
+		memcpy(&header, buf, sizeof(header));
+		if (memcmp(header.magic, SAVE_STATE_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != SAVE_STATE_VERSION
+			|| header.state_size != sizeof(Chip8State)
+			|| len < SAVE_STATE_SIZE) {
+			LOG_ERROR("Incompatible save state (version {}, {} bytes).", header.version, len);
+			return false;
+		} // end if (header mismatch)
+
+		// sp counts stack entries, key_wait_reg indexes V, and waiting_for_key must be a valid bool
+		const uint8_t* state = buf + sizeof(header);
+		const uint8_t* regs = state + offsetof(Chip8State, regs);
+		if (regs[offsetof(Chip8Registers, sp)] > 16
+			|| regs[offsetof(Chip8Registers, key_wait_reg)] > 0xF
+			|| regs[offsetof(Chip8Registers, waiting_for_key)] > 1) {
+			LOG_ERROR("Save state has out-of-range registers (sp {}, key register {}).",
+				regs[offsetof(Chip8Registers, sp)], regs[offsetof(Chip8Registers, key_wait_reg)]);
+			return false;
+		} // end if (bad registers)
+
+		this->restore_memory(state + offsetof(Chip8State, memory));
+		memcpy(static_cast<Chip8Registers*>(this), state + offsetof(Chip8State, regs), sizeof(Chip8Registers));
+		this->update_screen = true;
+		return true;
+	} // end Chip8::load_state()
 }
\ No newline at end of file
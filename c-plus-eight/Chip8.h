@@ -9,14 +9,15 @@
 
 #include <algorithm>
 #include <array>
-#include <bitset>
+#include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <memory>
-#include <random>
-#include <stack>
+#include <type_traits>
 
-#include "Renderer.h"
+#include "Hash.h"
+#include "MemoryPage.h"
+#include "SpscRing.h"
 
 #define OPCODE_X(op)        (op & 0x0F00) >> 8
 #define OPCODE_Y(op)        (op & 0x00F0) >> 4
@@ -31,42 +32,51 @@
 #define SCREEN_ROWS 32
 #define SCREEN_COLS 64
 
+/* Interpreter quirks (all clear = this emulator's original behavior) */
+#define QUIRK_SHIFT_VY      0x01    // 8xy6/8xyE shift Vy into Vx (COSMAC VIP)
+#define QUIRK_LOAD_STORE_I  0x02    // Fx55/Fx65 leave I unchanged (SCHIP)
+#define QUIRK_JUMP_VX       0x04    // Bxnn jumps to xnn + Vx (SCHIP)
+#define QUIRK_VF_RESET      0x08    // 8xy1/8xy2/8xy3 clear VF (COSMAC VIP)
+
 namespace c_plus_eight {
-    struct unknown_opcode_error : public std::exception {
+    /* The guest program did something the machine cannot run; pc is left at the faulting instruction */
+    struct machine_fault : public std::exception {
+    };
+
+    struct unknown_opcode_error : public machine_fault {
         const char* what() const throw() {
             return "Encountered an unknown opcode. Check log for more details.";
         }
     };
 
-    class Chip8
-    {
-    private:
-        /* Data for system font */
-        const std::array<unsigned char, 80> fontset = {
-            0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-            0x20, 0x60, 0x20, 0x20, 0x70, // 1
-            0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-            0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-            0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-            0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-            0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-            0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-            0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-            0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-            0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-            0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-            0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-            0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-            0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-            0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-        };
+    struct stack_error : public machine_fault {
+        const char* what() const throw() {
+            return "Stack overflow or underflow. Check log for more details.";
+        }
+    };
 
-        /* Current operation */
-        uint16_t opcode = 0;
+    /* Sound timer start/stop, timestamped in emulated cycles */
+    struct SoundEvent {
+        uint64_t cycle;
+        bool on;
+    };
 
-        /* System memory */
-        std::array<uint8_t, 4096> memory = {};
+    typedef SpscRing<SoundEvent, 64> SoundEventRing;
 
+    class BatchEngine;
+    class TraceWriter;
+
+    /* Pixel buffer: one word per row, top row first, bit 63 is the leftmost column */
+    typedef std::array<uint64_t, SCREEN_ROWS> Framebuffer;
+
+    static_assert(SCREEN_COLS == 64, "a framebuffer row must fit one uint64_t");
+
+    /**
+     * Guest-visible machine state except memory. Kept trivially copyable with an
+     * explicit, padding-free layout so it can be saved, restored and serialized with memcpy.
+     * Everything an instruction normally touches sits in the first cache line.
+     */
+    struct alignas(64) Chip8Registers {
         /* General purpose registers */
         std::array<uint8_t, 16> V = {};
 
@@ -76,28 +86,121 @@ namespace c_plus_eight {
         /* Program counter (initialized to start of program memory) */
         uint16_t pc = 0x200;
 
-        /* System graphics */
-        std::array<uint8_t, SCREEN_ROWS * SCREEN_COLS> graphics = {};
+        /* System keypad state (bit n set = key n pressed) */
+        uint16_t keys = 0;
 
         /* System timers */
 
         uint8_t delay_timer = 0;
         uint8_t sound_timer = 0;
 
+        /* Stack pointer */
+        uint8_t sp = 0;
+
+        /* Halt state for "LD Vx, K" (resumed by key_press) */
+        bool waiting_for_key = false;
+        uint8_t key_wait_reg = 0;
+
+        /* Enabled QUIRK_* flags */
+        uint8_t quirks = 0;
+
+        /* Number of 60 Hz frames (timer ticks) since power-on */
+        uint32_t frames = 0;
+
+        /* Number of emulated cycles, including those spent halted */
+        uint64_t cycles = 0;
+
+        /* PCG32 generator for "RND Vx, byte" and the seed it started from */
+        uint64_t rng_state = 0;
+        uint64_t rng_seed = 0;
+
+        uint8_t reserved[8] = {};
+
         /* System stack */
-        std::stack<uint16_t> stack;
+        std::array<uint16_t, 16> stack = {};
+
+        uint8_t reserved_stack[32] = {};
+
+        /* System graphics */
+        Framebuffer graphics = {};
+    };
+
+    /* Complete machine state, with memory flattened (used for snapshots and save states) */
+    struct Chip8State {
+        /* System memory */
+        std::array<uint8_t, MEMORY_PAGES * MEMORY_PAGE_SIZE> memory = {};
+
+        Chip8Registers regs;
+    };
 
-        /* Random device for "RND Vx, byte" */
-        std::random_device rd;
+    static_assert(std::is_trivially_copyable<Chip8State>::value, "Chip8State must be trivially copyable");
+    static_assert(sizeof(Chip8Registers) == 384 && offsetof(Chip8Registers, frames) == 28
+        && offsetof(Chip8Registers, stack) == 64 && offsetof(Chip8Registers, graphics) == 128, "Chip8Registers layout changed");
+    static_assert(sizeof(Chip8State) == 4480 && offsetof(Chip8State, regs) == 4096, "Chip8State layout changed");
 
-        /* System keypad state */
-        std::bitset<16> key = 0;
+    /* Header in front of a serialized Chip8State (host byte order) */
+    struct SaveStateHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t state_size;
+        uint32_t reserved;
+    };
+
+#define SAVE_STATE_MAGIC "C8SS"
+#define SAVE_STATE_VERSION 2
+#define SAVE_STATE_SIZE (sizeof(c_plus_eight::SaveStateHeader) + sizeof(c_plus_eight::Chip8State))
+
+#ifdef MEASURE_LATENCY
+    /* Input event sequence numbers, used to follow a key event to the screen */
+    struct InputProbe {
+        uint32_t applied = 0;   // last event passed to key_press/key_release
+        uint32_t read = 0;      // last event seen by SKP/SKNP/LD Vx, K
+        uint32_t drawn = 0;     // last event followed by a DRW that changed pixels
+    };
+#endif
+
+    class Chip8 : private Chip8Registers
+    {
+        /* Keeps the registers of many lanes in its own arrays */
+        friend class BatchEngine;
+
+        /* Places machines in its own memory and hands them a page pool */
+        friend class InstanceArena;
+
+    private:
+        /* System memory, shared copy-on-write with clones */
+        std::array<MemoryPage*, MEMORY_PAGES> pages;
+
+        /* One spare page per memory page to copy into on write (NULL = allocate); not copied */
+        MemoryPage* page_pool = NULL;
+
+        /* Current operation */
+        uint16_t opcode = 0;
 
         /* Flag for updating OpenGL pixel buffer */
         bool update_screen = true;
 
-        /* OpenGL renderer object */
-        std::unique_ptr<Renderer> r;
+        /* Queue for sound timer events (NULL if no audio is attached) */
+        SoundEventRing* sound_events = NULL;
+
+        /* Execution trace sink (NULL if not tracing) */
+        TraceWriter* trace = NULL;
+
+        /* Hash of the loaded ROM image (0 before load_game) */
+        uint64_t rom_hash = 0;
+
+        /* XOR-of-keys hashes of memory and the pixel buffer, kept up to date by
+           every write once state_hash() has computed them (see memory_key, row_key) */
+        mutable uint64_t memory_hash = 0;
+        mutable uint64_t graphics_hash = 0;
+        mutable bool hash_valid = false;
+
+        bool find_delay_loop(uint16_t& head) const;
+
+#ifdef MEASURE_LATENCY
+        /* Latency probe (not part of the saved state, so run-ahead rollbacks keep it) */
+        InputProbe input_probe;
+#endif
 
         /* Opcode functions */
 
@@ -116,12 +219,12 @@ namespace c_plus_eight {
         void op_xor_x_y(uint8_t x, uint8_t y);
         void op_add_x_y(uint8_t x, uint8_t y);
         void op_sub_x_y(uint8_t x, uint8_t y);
-        void op_shr_x(uint8_t x);
+        void op_shr_x(uint8_t x, uint8_t y);
         void op_subn_x_y(uint8_t x, uint8_t y);
-        void op_shl_x(uint8_t x);
+        void op_shl_x(uint8_t x, uint8_t y);
         void op_sne_x_y(uint8_t x, uint8_t y);
         void op_ld_I_nnn(uint16_t nnn);
-        void op_jp_0_nnn(uint16_t nnn);
+        void op_jp_0_nnn(uint8_t x, uint16_t nnn);
         void op_rnd_x_kk(uint8_t x, uint8_t kk);
         void op_drw_x_y_n(uint8_t x, uint8_t y, uint8_t n);
         void op_skp_x(uint8_t x);
@@ -136,18 +239,86 @@ namespace c_plus_eight {
         void op_ld_intoI_x(uint8_t x);
         void op_ld_x_fromI(uint8_t x);
 
-    public:
-        Chip8() {
-            this->r = std::make_unique<Renderer>();
-            std::copy(std::begin(fontset), std::end(fontset), std::begin(this->memory));
+        uint32_t next_random();
+
+        /* Draw the n-byte sprite at addr at (x, y); returns whether it erased a pixel */
+        bool draw_sprite(uint8_t x, uint8_t y, uint16_t addr, uint8_t n);
+
+        /* Memory access */
+
+        uint8_t read_memory(uint16_t addr) const { return this->pages[(addr >> 8) & 0xF]->bytes[addr & 0xFF]; }
+        uint8_t* page_for_write(uint16_t addr);
+        void write_memory(uint16_t addr, uint8_t value) {
+            uint8_t* page = this->page_for_write(addr);
+            if (this->hash_valid) {
+                this->memory_hash ^= memory_key(addr, page[addr & 0xFF]) ^ memory_key(addr, value);
+            }
+            page[addr & 0xFF] = value;
+        }
+        void load_memory(uint16_t addr, const uint8_t* data, size_t len);
+        void restore_memory(const uint8_t* memory);
+
+        /* Zero bytes hash to nothing, so untouched memory costs nothing to hash */
+        static uint64_t memory_key(uint16_t addr, uint8_t value) {
+            return (value != 0) ? hash64_key(MEMORY_HASH_SALT, ((addr & 0xFFF) << 8) | value) : 0;
         }
 
+        static uint64_t row_key(size_t row, uint64_t bits) {
+            return (bits != 0) ? hash64_mix(bits ^ hash64_key(GRAPHICS_HASH_SALT, row)) : 0;
+        }
+
+    public:
+        explicit Chip8(uint64_t rng_seed = 0);
+        Chip8(const Chip8& other);
+        Chip8& operator=(const Chip8& other);
+        ~Chip8();
+
+        /* Fork this machine: registers and graphics are copied, memory pages are shared until written */
+        std::unique_ptr<Chip8> clone() const { return std::make_unique<Chip8>(*this); }
+
         /* Functions for controlling the system externally */
 
         bool load_game(const char* file_path);
+        bool load_game(const uint8_t* data, size_t len);
         void key_press(uint8_t key_val);
         void key_release(uint8_t key_val);
+        void set_keys(uint16_t state);
         void emulate_cycle();
+        void run_cycles(unsigned int cycles);
+        void run_frame(unsigned int cycles);
         void tick();
+        void skip_frames(uint32_t count, unsigned int cycles);
+        void seed(uint64_t rng_seed);
+        void attach_sound(SoundEventRing* ring) { this->sound_events = ring; }
+        void attach_trace(TraceWriter* writer) { this->trace = writer; }
+        void set_quirks(uint8_t flags) { this->quirks = flags; }
+        void save_state(Chip8State& out) const;
+        void load_state(const Chip8State& in);
+        size_t save_state(uint8_t* buf, size_t len) const;
+        bool load_state(const uint8_t* buf, size_t len);
+
+        /* Functions for querying the system state from the host */
+
+        bool is_waiting_for_key() const { return this->waiting_for_key; }
+        uint8_t delay_wait_frames(unsigned int cycles) const;
+        bool timers_active() const { return this->delay_timer > 0 || this->sound_timer > 0; }
+        bool is_sound_on() const { return this->sound_timer > 0; }
+        uint64_t get_cycles() const { return this->cycles; }
+        uint64_t get_seed() const { return this->rng_seed; }
+        uint8_t get_quirks() const { return this->quirks; }
+        uint16_t get_keys() const { return this->keys; }
+        uint16_t get_pc() const { return this->pc; }
+        uint16_t get_index() const { return this->I; }
+        uint8_t get_register(uint8_t x) const { return this->V[x & 0xF]; }
+        uint8_t peek(uint16_t addr) const { return this->read_memory(addr); }
+        uint32_t get_frames() const { return this->frames; }
+        uint64_t get_rom_hash() const { return this->rom_hash; }
+        uint64_t frame_hash() const;
+        uint64_t state_hash() const;
+        bool consume_screen_update();
+        const Framebuffer* get_graphics() const { return &this->graphics; }
+#ifdef MEASURE_LATENCY
+        const InputProbe& get_input_probe() const { return this->input_probe; }
+#endif
     };
 }
\ No newline at end of file
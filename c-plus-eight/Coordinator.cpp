@@ -0,0 +1,179 @@
+/**
+ * Coordinator.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "Coordinator.h"
+#include "Hash.h"
+#include "Log.h"
+
+namespace c_plus_eight {
+	// processes = 0 starts one per hardware thread
+	Coordinator::Coordinator(unsigned int processes)
+		: process_count(processes)
+	{
+		if (this->process_count == 0) {
+			this->process_count = std::max(1u, std::thread::hardware_concurrency());
+		} // end if (process_count == 0)
+	}
+
+	void Coordinator::unmap()
+	{
+#ifndef _WIN32
+		if (this->base != NULL) {
+			munmap(this->base, this->length);
+		}
+#endif
+		this->base = NULL;
+		this->shared = NULL;
+		this->current = NULL;
+		this->results = NULL;
+	}
+
+	// Body of a worker process: claim jobs until there are none left
+	void Coordinator::work(unsigned int index, const std::vector<BatchJob>& jobs,
+		Shared* shared, std::atomic<int64_t>* current, ShardResult* results)
+	{
+		BootCache cache;
+		BatchRunner runner(cache, 1, false);
+		std::vector<BatchJob> one(1);
+
+		for (;;) {
+			uint64_t job = shared->next_job.fetch_add(1, std::memory_order_relaxed);
+			if (job >= jobs.size()) {
+				return;
+			} // end if (no jobs left)
+
+			current[index].store((int64_t)job, std::memory_order_release);
+			one[0] = jobs[job];
+			runner.run(one);
+
+			const BatchResult& r = runner.result(0);
+			ShardResult& out = results[job];
+			out.worker = index;
+			out.fault_pc = r.fault_pc;
+			out.frames = r.frames;
+			out.state_hash = r.state_hash;
+			out.frame_hash_digest = r.frame_hashes.empty() ? 0 : hash64(r.frame_hashes.data(), r.frame_hashes.size() * sizeof(uint64_t));
+			snprintf(out.fault, sizeof(out.fault), "%.*s", (int)sizeof(out.fault) - 1, r.fault);
+			out.status.store(r.status.load(std::memory_order_acquire), std::memory_order_release);
+			current[index].store(-1, std::memory_order_release);
+		} // end for (;;)
+	}
+
+	/**
+	 * Run every job and wait for the workers to finish. Returns false if the
+	 * shared table could not be mapped or no worker could be started. Forks,
+	 * so must be called while the process has no other threads.
+	 */
+	bool Coordinator::run(const std::vector<BatchJob>& jobs)
+	{
+#ifdef _WIN32
+		(void)jobs;
+		LOG_ERROR("Multi-process batch runs need fork(); use BatchRunner on Windows.");
+		return false;
+#else
+		this->unmap();
+		this->job_count = jobs.size();
+		this->restarts = 0;
+
+		// shared counter, per-worker current job, then the results table
+		size_t current_offset = 64;
+		size_t results_offset = (current_offset + this->process_count * sizeof(std::atomic<int64_t>) + 63) & ~(size_t)63;
+		this->length = results_offset + std::max<size_t>(jobs.size(), 1) * sizeof(ShardResult);
+		void* p = mmap(NULL, this->length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			LOG_ERROR("Could not map a results table for {} jobs.", jobs.size());
+			return false;
+		} // end if (p == MAP_FAILED)
+
+		// anonymous mappings come zeroed: next_job = 0 and every result BATCH_PENDING
+		this->base = static_cast<uint8_t*>(p);
+		this->shared = reinterpret_cast<Shared*>(this->base);
+		this->current = reinterpret_cast<std::atomic<int64_t>*>(this->base + current_offset);
+		this->results = reinterpret_cast<ShardResult*>(this->base + results_offset);
+		for (unsigned int w = 0; w < this->process_count; w++) {
+			this->current[w].store(-1, std::memory_order_relaxed);
+		}
+
+		std::vector<pid_t> pids(this->process_count, -1);
+		auto start = [&](unsigned int w) {
+			pid_t pid = fork();
+			if (pid == 0) {
+				work(w, jobs, this->shared, this->current, this->results);
+				_exit(0);
+			}
+			pids[w] = pid;
+			return pid > 0;
+		};
+
+		unsigned int running = 0;
+		for (unsigned int w = 0; w < this->process_count; w++) {
+			running += start(w) ? 1 : 0;
+		} // end for (w)
+		if (running == 0) {
+			LOG_ERROR("Could not start any worker processes.");
+			return false;
+		} // end if (running == 0)
+
+		while (running > 0) {
+			int status = 0;
+			pid_t pid = wait(&status);
+			if (pid < 0) {
+				break;
+			} // end if (no children)
+
+			auto it = std::find(pids.begin(), pids.end(), pid);
+			if (it == pids.end()) {
+				continue;
+			} // end if (not ours)
+			unsigned int w = (unsigned int)(it - pids.begin());
+			pids[w] = -1;
+			running--;
+
+			if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+				continue;
+			} // end if (clean exit)
+
+			// the job the worker was on takes the blame, everything it finished before stays
+			int64_t job = this->current[w].exchange(-1, std::memory_order_acq_rel);
+			if (job >= 0 && this->results[job].status.load(std::memory_order_acquire) == BATCH_PENDING) {
+				ShardResult& r = this->results[job];
+				r.worker = w;
+				snprintf(r.fault, sizeof(r.fault), "Worker died (%s %d).",
+					WIFSIGNALED(status) ? "signal" : "exit", WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+				r.status.store(SHARD_CRASHED, std::memory_order_release);
+				LOG_WARN("Worker {} died running job {} ({}).", w, job, jobs[job].rom_path);
+			} // end if (job >= 0)
+
+			if (this->shared->next_job.load(std::memory_order_relaxed) < jobs.size() && start(w)) {
+				this->restarts++;
+				running++;
+			} // end if (jobs left)
+		} // end while (running > 0)
+
+		// a worker killed between claiming a job and recording it leaves the job unowned
+		for (size_t job = 0; job < jobs.size(); job++) {
+			ShardResult& r = this->results[job];
+			if (r.status.load(std::memory_order_acquire) == BATCH_PENDING) {
+				snprintf(r.fault, sizeof(r.fault), "Worker died before running the job.");
+				r.status.store(SHARD_CRASHED, std::memory_order_release);
+			} // end if (BATCH_PENDING)
+		} // end for (job)
+
+		return true;
+#endif
+	}
+}
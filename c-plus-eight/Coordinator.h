@@ -0,0 +1,78 @@
+/**
+ * Coordinator.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BatchRunner.h"
+
+/* ShardResult status, beyond the BATCH_* values */
+#define SHARD_CRASHED 3
+
+namespace c_plus_eight {
+	/* Compact outcome of one job, one cache line in the shared results table */
+	struct alignas(64) ShardResult {
+		std::atomic<uint8_t> status;        // BATCH_PENDING, BATCH_DONE, BATCH_FAULT or SHARD_CRASHED
+		uint8_t reserved;
+		uint16_t fault_pc;
+		uint32_t frames;
+		uint64_t state_hash;
+		uint64_t frame_hash_digest;         // hash64 of the frame hashes, if the job kept them
+		uint32_t worker;                    // process slot that ran the job
+		char fault[36];
+	};
+
+	static_assert(sizeof(ShardResult) == 64, "ShardResult layout changed");
+
+	/**
+	 * Runs a job list across worker processes (POSIX only). The coordinator
+	 * maps a shared results table, then forks workers; each worker claims the
+	 * next job from a shared counter, runs it with a single-threaded
+	 * BatchRunner and writes the result into the job's row. A ROM that takes
+	 * its worker down (a crash, not an emulator fault) is marked
+	 * SHARD_CRASHED and the worker is forked again to carry on; results
+	 * already written are kept.
+	 *
+	 * Call run() before the program starts any threads of its own. Only the
+	 * calling thread survives fork(), so a lock another thread held at that
+	 * moment (inside malloc, say) stays locked forever in the workers.
+	 */
+	class Coordinator
+	{
+	private:
+		struct Shared {
+			std::atomic<uint64_t> next_job;
+		};
+
+		unsigned int process_count;
+		uint8_t* base = NULL;
+		size_t length = 0;
+		Shared* shared = NULL;
+		std::atomic<int64_t>* current = NULL;    // job each worker is running, -1 if none
+		ShardResult* results = NULL;
+		size_t job_count = 0;
+		unsigned int restarts = 0;
+
+		void unmap();
+		static void work(unsigned int index, const std::vector<BatchJob>& jobs,
+			Shared* shared, std::atomic<int64_t>* current, ShardResult* results);
+
+	public:
+		Coordinator(unsigned int processes = 0);
+		Coordinator(const Coordinator&) = delete;
+		Coordinator& operator=(const Coordinator&) = delete;
+		~Coordinator() { this->unmap(); }
+
+		bool run(const std::vector<BatchJob>& jobs);
+
+		unsigned int get_process_count() const { return this->process_count; }
+		unsigned int get_restarts() const { return this->restarts; }
+		const ShardResult& result(size_t job) const { return this->results[job]; }
+	};
+}
@@ -0,0 +1,192 @@
+/**
+ * CoreApi.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <new>
+
+#include "Chip8.h"
+#include "CoreApi.h"
+
+static_assert(C8_SCREEN_ROWS == SCREEN_ROWS && C8_SCREEN_COLUMNS == SCREEN_COLS, "screen size changed");
+static_assert(C8_QUIRK_SHIFT_VY == QUIRK_SHIFT_VY && C8_QUIRK_LOAD_STORE_I == QUIRK_LOAD_STORE_I
+	&& C8_QUIRK_JUMP_VX == QUIRK_JUMP_VX && C8_QUIRK_VF_RESET == QUIRK_VF_RESET, "quirk flags changed");
+
+// ROMs load at 0x200 and may fill the rest of memory
+#define C8_MAX_ROM_SIZE (4096 - 0x200)
+
+struct c8_machine {
+	c_plus_eight::Chip8 emu;
+
+	c8_machine(uint64_t seed) : emu(seed) {}
+	c8_machine(const c8_machine& other) : emu(other.emu) {}
+};
+
+extern "C" {
+	uint32_t c8_abi_version(void)
+	{
+		return C8_ABI_VERSION;
+	}
+
+	c8_machine* c8_create(uint64_t seed)
+	{
+		return new (std::nothrow) c8_machine(seed);
+	}
+
+	// New machine sharing m's memory pages until either one writes
+	c8_machine* c8_clone(const c8_machine* m)
+	{
+		return (m != NULL) ? new (std::nothrow) c8_machine(*m) : NULL;
+	}
+
+	void c8_destroy(c8_machine* m)
+	{
+		delete m;
+	}
+
+	int c8_load_rom(c8_machine* m, const uint8_t* data, size_t len)
+	{
+		if (m == NULL || (data == NULL && len != 0)) {
+			return C8_ERR_ARGUMENT;
+		} // end if (bad arguments)
+		if (len > C8_MAX_ROM_SIZE) {
+			return C8_ERR_ROM_TOO_LARGE;
+		} // end if (len > C8_MAX_ROM_SIZE)
+
+		try {
+			m->emu.load_game(data, len);
+		}
+		catch (const std::bad_alloc&) {
+			return C8_ERR_OUT_OF_MEMORY;
+		} // end try
+		return C8_OK;
+	}
+
+	void c8_set_quirks(c8_machine* m, uint8_t quirks)
+	{
+		if (m != NULL) {
+			m->emu.set_quirks(quirks);
+		}
+	}
+
+	int c8_run_cycles(c8_machine* m, uint32_t cycles)
+	{
+		if (m == NULL) {
+			return C8_ERR_ARGUMENT;
+		} // end if (m == NULL)
+
+		try {
+			m->emu.run_cycles(cycles);
+		}
+		catch (const c_plus_eight::unknown_opcode_error&) {
+			return C8_ERR_UNKNOWN_OPCODE;
+		}
+		catch (const c_plus_eight::stack_error&) {
+			return C8_ERR_STACK;
+		}
+		catch (const std::bad_alloc&) {
+			return C8_ERR_OUT_OF_MEMORY;
+		} // end try
+		return C8_OK;
+	}
+
+	// Several frames per call, so FFI overhead is paid once for all of them
+	int c8_run_frames(c8_machine* m, uint32_t frames, uint32_t cycles_per_frame)
+	{
+		if (m == NULL) {
+			return C8_ERR_ARGUMENT;
+		} // end if (m == NULL)
+
+		try {
+			for (uint32_t f = 0; f < frames; f++) {
+				m->emu.run_frame(cycles_per_frame);
+			}
+		}
+		catch (const c_plus_eight::unknown_opcode_error&) {
+			return C8_ERR_UNKNOWN_OPCODE;
+		}
+		catch (const c_plus_eight::stack_error&) {
+			return C8_ERR_STACK;
+		}
+		catch (const std::bad_alloc&) {
+			return C8_ERR_OUT_OF_MEMORY;
+		} // end try
+		return C8_OK;
+	}
+
+	void c8_set_keys(c8_machine* m, uint16_t keys)
+	{
+		if (m != NULL) {
+			m->emu.set_keys(keys);
+		}
+	}
+
+	// The machine's own rows, valid until it is destroyed
+	const uint64_t* c8_framebuffer(const c8_machine* m)
+	{
+		return (m != NULL) ? m->emu.get_graphics()->data() : NULL;
+	}
+
+	int c8_sound_on(const c8_machine* m)
+	{
+		return (m != NULL && m->emu.is_sound_on()) ? 1 : 0;
+	}
+
+	int c8_waiting_for_key(const c8_machine* m)
+	{
+		return (m != NULL && m->emu.is_waiting_for_key()) ? 1 : 0;
+	}
+
+	uint32_t c8_frames(const c8_machine* m)
+	{
+		return (m != NULL) ? m->emu.get_frames() : 0;
+	}
+
+	uint64_t c8_cycles(const c8_machine* m)
+	{
+		return (m != NULL) ? m->emu.get_cycles() : 0;
+	}
+
+	uint8_t c8_peek(const c8_machine* m, uint16_t addr)
+	{
+		return (m != NULL) ? m->emu.peek(addr) : 0;
+	}
+
+	uint64_t c8_frame_hash(const c8_machine* m)
+	{
+		return (m != NULL) ? m->emu.frame_hash() : 0;
+	}
+
+	uint64_t c8_state_hash(const c8_machine* m)
+	{
+		return (m != NULL) ? m->emu.state_hash() : 0;
+	}
+
+	size_t c8_state_size(void)
+	{
+		return SAVE_STATE_SIZE;
+	}
+
+	int c8_save_state(const c8_machine* m, uint8_t* buf, size_t len)
+	{
+		if (m == NULL || buf == NULL) {
+			return C8_ERR_ARGUMENT;
+		} // end if (bad arguments)
+
+		return (m->emu.save_state(buf, len) != 0) ? C8_OK : C8_ERR_ARGUMENT;
+	}
+
+	int c8_load_state(c8_machine* m, const uint8_t* buf, size_t len)
+	{
+		if (m == NULL || buf == NULL) {
+			return C8_ERR_ARGUMENT;
+		} // end if (bad arguments)
+
+		try {
+			return m->emu.load_state(buf, len) ? C8_OK : C8_ERR_BAD_STATE;
+		}
+		catch (const std::bad_alloc&) {
+			return C8_ERR_OUT_OF_MEMORY;
+		} // end try
+	}
+}
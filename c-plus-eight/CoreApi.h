@@ -0,0 +1,93 @@
+/**
+ * CoreApi.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+/*
+ * C interface to the emulator core, for embedding it in other languages
+ * through FFI. Machines are opaque handles. Nothing here allocates except
+ * c8_create (and the first write to each memory page of a fresh machine),
+ * no call throws, and functions that can fail return a C8_* status.
+ *
+ * The ABI only ever grows: functions are added, never changed or removed,
+ * and C8_ABI_VERSION is bumped when they are. Check c8_abi_version() at
+ * load time.
+ */
+
+#ifndef C8_CORE_API_H
+#define C8_CORE_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define C8_ABI_VERSION 1
+
+/* Status codes */
+#define C8_OK 0
+#define C8_ERR_ARGUMENT -1          /* NULL handle or buffer, or a bad length */
+#define C8_ERR_ROM_TOO_LARGE -2
+#define C8_ERR_UNKNOWN_OPCODE -3    /* the machine stopped at an opcode it does not know */
+#define C8_ERR_BAD_STATE -4         /* save state is truncated or from another version */
+#define C8_ERR_OUT_OF_MEMORY -5
+#define C8_ERR_STACK -6             /* CALL with all 16 stack entries in use, or RET with none */
+
+/* c8_set_quirks flags, the same as QUIRK_* in Chip8.h */
+#define C8_QUIRK_SHIFT_VY 0x01
+#define C8_QUIRK_LOAD_STORE_I 0x02
+#define C8_QUIRK_JUMP_VX 0x04
+#define C8_QUIRK_VF_RESET 0x08
+
+/* Framebuffer rows and columns; row r is c8_framebuffer()[r], bit 63 the leftmost pixel */
+#define C8_SCREEN_ROWS 32
+#define C8_SCREEN_COLUMNS 64
+
+#ifdef _WIN32
+#define C8_API __declspec(dllexport)
+#else
+#define C8_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct c8_machine c8_machine;
+
+C8_API uint32_t c8_abi_version(void);
+
+/* Lifetime */
+C8_API c8_machine* c8_create(uint64_t seed);
+C8_API c8_machine* c8_clone(const c8_machine* m);
+C8_API void c8_destroy(c8_machine* m);
+
+/* Setup */
+C8_API int c8_load_rom(c8_machine* m, const uint8_t* data, size_t len);
+C8_API void c8_set_quirks(c8_machine* m, uint8_t quirks);
+
+/* Running: a frame is cycles_per_frame instructions followed by a 60 Hz timer tick */
+C8_API int c8_run_cycles(c8_machine* m, uint32_t cycles);
+C8_API int c8_run_frames(c8_machine* m, uint32_t frames, uint32_t cycles_per_frame);
+
+/* Input: bit n of keys is key n held down */
+C8_API void c8_set_keys(c8_machine* m, uint16_t keys);
+
+/* Output */
+C8_API const uint64_t* c8_framebuffer(const c8_machine* m);
+C8_API int c8_sound_on(const c8_machine* m);
+C8_API int c8_waiting_for_key(const c8_machine* m);
+C8_API uint32_t c8_frames(const c8_machine* m);
+C8_API uint64_t c8_cycles(const c8_machine* m);
+C8_API uint8_t c8_peek(const c8_machine* m, uint16_t addr);
+C8_API uint64_t c8_frame_hash(const c8_machine* m);
+C8_API uint64_t c8_state_hash(const c8_machine* m);
+
+/* Save states: c8_state_size() bytes, portable between machines of the same ABI version */
+C8_API size_t c8_state_size(void);
+C8_API int c8_save_state(const c8_machine* m, uint8_t* buf, size_t len);
+C8_API int c8_load_state(c8_machine* m, const uint8_t* buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
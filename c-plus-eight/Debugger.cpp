@@ -0,0 +1,216 @@
+/**
+ * Debugger.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <algorithm>
+#include "Debugger.h"
+
+namespace c_plus_eight {
+	// The machine must be at a frame boundary (between run_frame calls)
+	Debugger::Debugger(Chip8& emu, unsigned int cycles_per_frame)
+		: emu(emu), cycles_per_frame(cycles_per_frame)
+	{
+		this->cycle_base = emu.get_cycles() - (uint64_t)emu.get_frames() * cycles_per_frame;
+		this->end_cycle = emu.get_cycles();
+		this->keyframes.push_back({ emu.get_cycles(), emu });
+	}
+
+	uint64_t Debugger::frame_end() const
+	{
+		return this->cycle_base + ((uint64_t)this->emu.get_frames() + 1) * this->cycles_per_frame;
+	}
+
+	// Apply the recorded keypad changes at the current position
+	void Debugger::apply_inputs()
+	{
+		uint64_t now = this->emu.get_cycles();
+		while (this->next_input < this->inputs.size() && this->inputs[this->next_input].cycle <= now) {
+			this->emu.set_keys(this->inputs[this->next_input].keys);
+			this->next_input++;
+		}
+	}
+
+	// Run forward to target, replaying recorded input and ticking the timers at frame boundaries
+	void Debugger::advance_to(uint64_t target)
+	{
+		this->apply_inputs();
+		while (this->emu.get_cycles() < target) {
+			uint64_t now = this->emu.get_cycles();
+			uint64_t boundary = this->frame_end();
+			uint64_t stop = std::min(target, boundary);
+			if (this->next_input < this->inputs.size()) {
+				stop = std::min(stop, this->inputs[this->next_input].cycle);
+			} // end if (pending input)
+
+			this->emu.run_cycles((unsigned int)(stop - now));
+			if (stop == boundary) {
+				this->emu.tick();
+
+				// keyframes are only taken on new ground, before any input arrives there
+				if (stop > this->end_cycle && (this->emu.get_frames() % DEBUGGER_KEYFRAME_INTERVAL) == 0) {
+					this->keyframes.push_back({ stop, this->emu });
+				} // end if (new keyframe)
+			} // end if (stop == boundary)
+
+			this->end_cycle = std::max(this->end_cycle, stop);
+			this->apply_inputs();
+		} // end while (get_cycles() < target)
+	}
+
+	void Debugger::restore(size_t keyframe)
+	{
+		const Keyframe& k = this->keyframes[keyframe];
+		this->emu = k.machine;
+		this->next_input = std::lower_bound(this->inputs.begin(), this->inputs.end(), k.cycle,
+			[](const InputEvent& e, uint64_t c) { return e.cycle < c; }) - this->inputs.begin();
+		this->apply_inputs();
+	}
+
+	// New input in the past replaces the recorded future
+	void Debugger::truncate()
+	{
+		uint64_t now = this->emu.get_cycles();
+		if (now >= this->end_cycle) {
+			return;
+		} // end if (now >= end_cycle)
+
+		this->inputs.resize(this->next_input);
+		while (this->keyframes.back().cycle > now) {
+			this->keyframes.pop_back();
+		}
+		this->end_cycle = now;
+	}
+
+	void Debugger::key_press(uint8_t key_val)
+	{
+		this->truncate();
+		this->emu.key_press(key_val);
+		this->inputs.push_back({ this->emu.get_cycles(), this->emu.get_keys() });
+		this->next_input = this->inputs.size();
+	}
+
+	void Debugger::key_release(uint8_t key_val)
+	{
+		this->truncate();
+		this->emu.key_release(key_val);
+		this->inputs.push_back({ this->emu.get_cycles(), this->emu.get_keys() });
+		this->next_input = this->inputs.size();
+	}
+
+	// Execute one instruction (or, while halted on "LD Vx, K", the rest of the frame)
+	void Debugger::step()
+	{
+		if (this->emu.is_waiting_for_key()) {
+			this->advance_to(this->frame_end());
+		}
+		else {
+			this->advance_to(this->emu.get_cycles() + 1);
+		} // end if (is_waiting_for_key)
+	}
+
+	void Debugger::run_frame()
+	{
+		this->advance_to(this->frame_end());
+	}
+
+	// Go to any position: replay from the nearest keyframe before it (or run forward past the end)
+	void Debugger::seek(uint64_t cycle)
+	{
+		if (cycle < this->emu.get_cycles()) {
+			size_t k = std::upper_bound(this->keyframes.begin(), this->keyframes.end(), cycle,
+				[](uint64_t c, const Keyframe& f) { return c < f.cycle; }) - this->keyframes.begin();
+			this->restore((k > 0) ? k - 1 : 0);
+		} // end if (cycle < get_cycles())
+
+		this->advance_to(cycle);
+	}
+
+	/**
+	 * Find the latest step before the current position that watch reports.
+	 * watch is called at the start of each replayed segment and after every
+	 * cycle, and returns whether the cycle just run is a match. Segments are
+	 * replayed newest first, so only the history back to the match is
+	 * revisited. Ends at the start of the matching cycle.
+	 */
+	bool Debugger::scan_back(const std::function<bool(const Chip8&)>& watch)
+	{
+		uint64_t start = this->emu.get_cycles();
+		uint64_t limit = start;
+		size_t k = std::lower_bound(this->keyframes.begin(), this->keyframes.end(), limit,
+			[](const Keyframe& f, uint64_t c) { return f.cycle < c; }) - this->keyframes.begin();
+
+		while (k-- > 0) {
+			this->restore(k);
+			watch(this->emu);
+
+			uint64_t found = UINT64_MAX;
+			while (this->emu.get_cycles() < limit) {
+				uint64_t now = this->emu.get_cycles();
+				this->advance_to(now + 1);
+				if (watch(this->emu)) {
+					found = now;
+				} // end if (watch)
+			} // end while (get_cycles() < limit)
+
+			if (found != UINT64_MAX) {
+				this->seek(found);
+				return true;
+			} // end if (found)
+
+			limit = this->keyframes[k].cycle;
+		} // end while (k-- > 0)
+
+		this->seek(start);
+		return false;
+	}
+
+	// Back to the start of the previous instruction
+	bool Debugger::reverse_step()
+	{
+		bool executes = false;
+		return this->scan_back([&executes](const Chip8& m) {
+			bool hit = executes;
+			executes = !m.is_waiting_for_key();
+			return hit;
+		});
+	}
+
+	// Back to the last instruction that stored to addr ("LD B, Vx" or "LD [I], Vx")
+	bool Debugger::reverse_continue_write(uint16_t addr)
+	{
+		bool writes = false;
+		return this->scan_back([&writes, addr](const Chip8& m) {
+			bool hit = writes;
+			uint16_t op = (m.peek(m.get_pc()) << 8) | m.peek(m.get_pc() + 1);
+			uint16_t offset = (addr - m.get_index()) & 0xFFF;
+			if (m.is_waiting_for_key()) {
+				writes = false;
+			}
+			else if ((op & 0xF0FF) == 0xF033) {
+				writes = offset < 3;
+			}
+			else if ((op & 0xF0FF) == 0xF055) {
+				writes = offset <= OPCODE_X(op);
+			}
+			else {
+				writes = false;
+			} // end if (op)
+			return hit;
+		});
+	}
+
+	// Back to the last instruction that changed the pixel
+	bool Debugger::reverse_continue_pixel(uint8_t row, uint8_t col)
+	{
+		size_t index = row % SCREEN_ROWS;
+		uint64_t mask = 1ULL << (63 - (col % SCREEN_COLS));
+		uint64_t last = 0;
+		return this->scan_back([&last, index, mask](const Chip8& m) {
+			uint64_t value = (*m.get_graphics())[index] & mask;
+			bool hit = value != last;
+			last = value;
+			return hit;
+		});
+	}
+}
@@ -0,0 +1,84 @@
+/**
+ * Debugger.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Chip8.h"
+
+// frames between the keyframes replays start from
+#define DEBUGGER_KEYFRAME_INTERVAL 60
+
+namespace c_plus_eight {
+	/**
+	 * Time-travel debugger around a running machine. Going forward it records
+	 * every keypad change with the cycle it happened at and keeps a clone of
+	 * the machine every DEBUGGER_KEYFRAME_INTERVAL frames (clones share
+	 * unchanged memory pages, so keyframes are cheap). Going backward restores
+	 * the nearest earlier keyframe and replays the recorded input forward with
+	 * run_cycles(), so any earlier cycle can be revisited exactly.
+	 *
+	 * Positions are Chip8::get_cycles() values. The host must drive the machine
+	 * only through the debugger while it is attached, and should detach audio:
+	 * replays re-run the sound timer.
+	 */
+	class Debugger
+	{
+	private:
+		struct Keyframe {
+			uint64_t cycle;
+			Chip8 machine;
+		};
+
+		struct InputEvent {
+			uint64_t cycle;
+			uint16_t keys;  // whole keypad after the change
+		};
+
+		Chip8& emu;
+		unsigned int cycles_per_frame;
+
+		/* Cycle count at frame 0, so frame boundaries are cycle_base + frames * cycles_per_frame */
+		uint64_t cycle_base;
+
+		std::vector<Keyframe> keyframes;
+		std::vector<InputEvent> inputs;
+		size_t next_input = 0;
+
+		/* Furthest position reached; inputs and keyframes beyond it do not exist yet */
+		uint64_t end_cycle;
+
+		uint64_t frame_end() const;
+		void apply_inputs();
+		void advance_to(uint64_t target);
+		void restore(size_t keyframe);
+		void truncate();
+		bool scan_back(const std::function<bool(const Chip8&)>& watch);
+
+	public:
+		Debugger(Chip8& emu, unsigned int cycles_per_frame);
+
+		/* Forward, recording new input at the end of the timeline */
+
+		void key_press(uint8_t key_val);
+		void key_release(uint8_t key_val);
+		void step();
+		void run_frame();
+
+		/* Backward (all return false and stay put if there is nothing to go back to) */
+
+		void seek(uint64_t cycle);
+		bool reverse_step();
+		bool reverse_continue_write(uint16_t addr);
+		bool reverse_continue_pixel(uint8_t row, uint8_t col);
+
+		uint64_t position() const { return this->emu.get_cycles(); }
+		uint64_t end() const { return this->end_cycle; }
+		size_t keyframe_count() const { return this->keyframes.size(); }
+	};
+}
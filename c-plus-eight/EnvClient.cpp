@@ -0,0 +1,211 @@
+/**
+ * EnvClient.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "EnvClient.h"
+#include "Log.h"
+
+namespace c_plus_eight {
+	// The words live in memory shared between processes, so no FUTEX_PRIVATE_FLAG
+	void env_futex_wait(std::atomic<uint32_t>* word, uint32_t expected)
+	{
+		// wake up now and then in case the other side went away
+		struct timespec timeout = { 0, ENV_POLL_MS * 1000 * 1000 };
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, NULL, 0);
+	}
+
+	void env_futex_wake(std::atomic<uint32_t>* word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+	}
+
+	// A process that has exited but not been reaped yet (e.g. a forked server) counts as gone
+	bool env_process_alive(uint32_t pid)
+	{
+		if (kill((pid_t)pid, 0) != 0 && errno == ESRCH) {
+			return false;
+		} // end if (no such process)
+
+		char path[32];
+		snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+		FILE* f = fopen(path, "r");
+		if (f == NULL) {
+			return true;
+		}
+		char stat[256];
+		size_t len = fread(stat, 1, sizeof(stat) - 1, f);
+		fclose(f);
+		stat[len] = '\0';
+
+		// the state follows the command name, which may itself contain ") "
+		const char* end = strrchr(stat, ')');
+		return end == NULL || end[1] == '\0' || (end[2] != 'Z' && end[2] != 'X');
+	}
+
+	static uint64_t monotonic_ms()
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+	}
+
+	/**
+	 * Spin, then sleep, until *word != last, leaving the new value in now.
+	 * Returns false instead if the process peer_pid (0 = none to watch) exits
+	 * or timeout_ms (0 = no limit) passes first.
+	 */
+	bool env_wait_change(std::atomic<uint32_t>* word, uint32_t last, uint32_t& now, uint32_t peer_pid,
+		uint32_t timeout_ms)
+	{
+		uint64_t start = 0;
+		for (;;) {
+			for (int spin = 0; spin < ENV_SPIN_COUNT; spin++) {
+				now = word->load(std::memory_order_acquire);
+				if (now != last) {
+					return true;
+				}
+			}
+
+			if (timeout_ms != 0) {
+				uint64_t t = monotonic_ms();
+				if (start == 0) {
+					start = t;
+				}
+				else if (t - start >= timeout_ms) {
+					return false;
+				}
+			} // end if (timeout_ms != 0)
+			if (peer_pid != 0 && !env_process_alive(peer_pid)) {
+				return false;
+			}
+
+			env_futex_wait(word, last);
+		} // end for (;;)
+	}
+
+	// Attach to the region a server created under name (e.g. "/c8env")
+	bool EnvClient::connect(const char* name)
+	{
+		this->disconnect();
+
+		int fd = shm_open(name, O_RDWR, 0);
+		if (fd < 0) {
+			LOG_ERROR("No environment server at '{}'.", name);
+			return false;
+		} // end if (fd < 0)
+
+		struct stat st;
+		void* p = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(EnvSharedHeader)) {
+			p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if (p == MAP_FAILED) {
+			LOG_ERROR("Could not map environment server region '{}'.", name);
+			return false;
+		} // end if (p == MAP_FAILED)
+
+		EnvSharedHeader* h = static_cast<EnvSharedHeader*>(p);
+		EnvLayout l = env_layout(h->count);
+		if (memcmp(h->magic, ENV_SHM_MAGIC, 4) != 0 || h->version != ENV_SHM_VERSION
+			|| h->region_size != l.total || (size_t)st.st_size < l.total) {
+			LOG_ERROR("'{}' is not a compatible environment server region.", name);
+			munmap(p, (size_t)st.st_size);
+			return false;
+		} // end if (bad header)
+
+		this->base = static_cast<uint8_t*>(p);
+		this->length = (size_t)st.st_size;
+		this->layout = l;
+		this->header = h;
+		this->seq = h->command_seq.load(std::memory_order_acquire);
+		h->client_pid = (uint32_t)getpid();
+		return true;
+	}
+
+	void EnvClient::disconnect()
+	{
+		if (this->base != NULL) {
+			munmap(this->base, this->length);
+		}
+		this->base = NULL;
+		this->header = NULL;
+	}
+
+	/**
+	 * Post a command and wait for its results. Fails if not connected, or if
+	 * the server process exits or the results take longer than the timeout.
+	 * The server may still be writing the ring then, so the client
+	 * disconnects rather than post more commands and read half-written slots.
+	 */
+	bool EnvClient::run(uint32_t command, EnvStepView& view)
+	{
+		if (this->header == NULL) {
+			return false;
+		} // end if (not connected)
+
+		this->header->command = command;
+		this->seq++;
+		this->header->command_seq.store(this->seq, std::memory_order_release);
+		env_futex_wake(&this->header->command_seq);
+
+		uint32_t now = this->seq - 1;
+		while (now != this->seq) {
+			if (!env_wait_change(&this->header->result_seq, now, now, this->header->server_pid, this->timeout_ms)) {
+				LOG_ERROR("Environment server (pid {}) did not answer command {}.", this->header->server_pid, this->seq);
+				this->disconnect();
+				return false;
+			}
+		} // end while (now != seq)
+
+		const uint8_t* slot = this->base + this->layout.ring + (this->seq % ENV_RING_SLOTS) * this->layout.slot_size;
+		memcpy(&view.step, slot, sizeof(view.step));
+		view.observations = reinterpret_cast<const Framebuffer*>(slot + this->layout.observations);
+		view.rewards = reinterpret_cast<const float*>(slot + this->layout.rewards);
+		view.terminals = slot + this->layout.terminals;
+		view.truncations = slot + this->layout.truncations;
+		return true;
+	}
+
+	bool EnvClient::step(const uint32_t* actions, EnvStepView& view)
+	{
+		if (this->header == NULL) {
+			return false;
+		} // end if (not connected)
+		memcpy(this->actions(), actions, this->size() * sizeof(uint32_t));
+		return this->run(ENV_CMD_STEP, view);
+	}
+
+	bool EnvClient::reset(uint64_t seed, EnvStepView& view)
+	{
+		if (this->header == NULL) {
+			return false;
+		} // end if (not connected)
+		this->header->seed = seed;
+		return this->run(ENV_CMD_RESET, view);
+	}
+
+	// Stop the server's serve() loop
+	bool EnvClient::shutdown()
+	{
+		EnvStepView view;
+		return this->run(ENV_CMD_SHUTDOWN, view);
+	}
+}
+
+#endif
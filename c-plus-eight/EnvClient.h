@@ -0,0 +1,68 @@
+/**
+ * EnvClient.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Chip8.h"
+#include "EnvShared.h"
+
+namespace c_plus_eight {
+	/* Results of one command, pointing into the shared region */
+	struct EnvStepView {
+		uint64_t step;
+		const Framebuffer* observations;
+		const float* rewards;
+		const uint8_t* terminals;
+		const uint8_t* truncations;
+	};
+
+	/**
+	 * Trainer side of an EnvServer (Linux only). Actions are written straight
+	 * into the shared region and results are read from it in place; the views
+	 * stay valid until ENV_RING_SLOTS further commands have been posted. One
+	 * client per server. Commands fail rather than wait forever if the
+	 * server process exits or stops answering; the client is disconnected
+	 * then, and every view it returned is invalid.
+	 */
+	class EnvClient
+	{
+	private:
+		uint8_t* base = NULL;
+		size_t length = 0;
+		EnvLayout layout;
+		EnvSharedHeader* header = NULL;
+		uint32_t seq = 0;
+		uint32_t timeout_ms = ENV_DEFAULT_TIMEOUT_MS;
+
+		bool run(uint32_t command, EnvStepView& view);
+
+	public:
+		EnvClient() {}
+		EnvClient(const EnvClient&) = delete;
+		EnvClient& operator=(const EnvClient&) = delete;
+		~EnvClient() { this->disconnect(); }
+
+		bool connect(const char* name);
+		void disconnect();
+
+		bool connected() const { return this->header != NULL; }
+		size_t size() const { return (this->header != NULL) ? this->header->count : 0; }
+		uint32_t action_count() const { return (this->header != NULL) ? this->header->action_count : 0; }
+
+		/* Action slots for the next step, one per instance */
+		uint32_t* actions() { return (this->base != NULL) ? reinterpret_cast<uint32_t*>(this->base + this->layout.actions) : NULL; }
+
+		/* Longest wait for the results of a command, 0 to wait as long as the server is running */
+		void set_timeout(uint32_t ms) { this->timeout_ms = ms; }
+
+		bool step(EnvStepView& view) { return this->run(ENV_CMD_STEP, view); }
+		bool step(const uint32_t* actions, EnvStepView& view);
+		bool reset(uint64_t seed, EnvStepView& view);
+		bool shutdown();
+	};
+}
@@ -0,0 +1,122 @@
+/**
+ * EnvServer.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <new>
+
+#include "EnvServer.h"
+#include "Log.h"
+
+namespace c_plus_eight {
+	// Create the shared region under name (e.g. "/c8env"), replacing any stale one
+	bool EnvServer::open(const char* name)
+	{
+		this->close();
+
+		this->layout = env_layout(this->env.size());
+		shm_unlink(name);
+		int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) {
+			LOG_ERROR("Could not create shared memory '{}'.", name);
+			return false;
+		} // end if (fd < 0)
+
+		void* p = MAP_FAILED;
+		if (ftruncate(fd, (off_t)this->layout.total) == 0) {
+			p = mmap(NULL, this->layout.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if (p == MAP_FAILED) {
+			LOG_ERROR("Could not map shared memory '{}'.", name);
+			shm_unlink(name);
+			return false;
+		} // end if (p == MAP_FAILED)
+
+		this->base = static_cast<uint8_t*>(p);
+		this->name = name;
+
+		// the region comes zeroed, only the header needs filling in
+		EnvSharedHeader* h = new (this->base) EnvSharedHeader();
+		memcpy(h->magic, ENV_SHM_MAGIC, 4);
+		h->version = ENV_SHM_VERSION;
+		h->count = (uint32_t)this->env.size();
+		h->action_count = (uint32_t)this->env.action_count();
+		h->region_size = this->layout.total;
+		h->command_seq.store(0, std::memory_order_relaxed);
+		h->result_seq.store(0, std::memory_order_relaxed);
+		h->server_pid = (uint32_t)getpid();
+		this->header = h;
+
+		// results of the environment's current state, for a client that reads before stepping
+		this->publish(0);
+		return true;
+	}
+
+	void EnvServer::close()
+	{
+		if (this->base != NULL) {
+			munmap(this->base, this->layout.total);
+			shm_unlink(this->name.c_str());
+		}
+		this->base = NULL;
+		this->header = NULL;
+	}
+
+	// Copy the environment's latest results into slot seq and tell the client
+	void EnvServer::publish(uint32_t seq)
+	{
+		const EnvLayout& l = this->layout;
+		size_t count = this->env.size();
+		uint8_t* slot = this->base + l.ring + (seq % ENV_RING_SLOTS) * l.slot_size;
+
+		memcpy(slot, &this->steps, sizeof(this->steps));
+		for (size_t i = 0; i < count; i++) {
+			memcpy(slot + l.observations + i * sizeof(Framebuffer), this->env.observation(i).data(), sizeof(Framebuffer));
+		} // end for (i)
+		memcpy(slot + l.rewards, this->env.get_rewards(), count * sizeof(float));
+		memcpy(slot + l.terminals, this->env.get_terminals(), count);
+		memcpy(slot + l.truncations, this->env.get_truncations(), count);
+
+		this->header->result_seq.store(seq, std::memory_order_release);
+		env_futex_wake(&this->header->result_seq);
+	}
+
+	// Run commands until the client sends ENV_CMD_SHUTDOWN or exits, returns the number of steps run
+	uint64_t EnvServer::serve()
+	{
+		EnvSharedHeader* h = this->header;
+		const uint32_t* actions = reinterpret_cast<const uint32_t*>(this->base + this->layout.actions);
+		uint32_t seq = h->command_seq.load(std::memory_order_acquire);
+
+		for (;;) {
+			// the client may sit between commands for as long as it likes, but not die
+			if (!env_wait_change(&h->command_seq, seq, seq, h->client_pid, 0)) {
+				LOG_WARN("Environment client (pid {}) exited without shutting the server down.", h->client_pid);
+				return this->steps;
+			}
+			uint32_t command = h->command;
+
+			if (command == ENV_CMD_STEP) {
+				this->env.step(actions);
+				this->steps++;
+			}
+			else if (command == ENV_CMD_RESET) {
+				this->env.reset(h->seed);
+			} // end if (command)
+
+			this->publish(seq);
+			if (command == ENV_CMD_SHUTDOWN) {
+				return this->steps;
+			} // end if (ENV_CMD_SHUTDOWN)
+		} // end for (;;)
+	}
+}
+
+#endif
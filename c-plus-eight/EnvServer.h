@@ -0,0 +1,47 @@
+/**
+ * EnvServer.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "EnvShared.h"
+#include "Environment.h"
+
+namespace c_plus_eight {
+	/**
+	 * Serves an Environment to a trainer in another process on the same host
+	 * (Linux only). Everything is exchanged through a POSIX shared-memory
+	 * region: the client writes actions into it and signals a futex, the
+	 * server steps and writes observations, rewards and done flags into the
+	 * next slot of a small result ring and signals back. Nothing is encoded
+	 * or sent over a socket. See EnvShared.h for the layout and EnvClient for
+	 * the other side.
+	 */
+	class EnvServer
+	{
+	private:
+		Environment& env;
+		std::string name;
+		uint8_t* base = NULL;
+		EnvLayout layout;
+		EnvSharedHeader* header = NULL;
+		uint64_t steps = 0;
+
+		void publish(uint32_t seq);
+
+	public:
+		EnvServer(Environment& env) : env(env) {}
+		EnvServer(const EnvServer&) = delete;
+		EnvServer& operator=(const EnvServer&) = delete;
+		~EnvServer() { this->close(); }
+
+		bool open(const char* name);
+		void close();
+		uint64_t serve();
+	};
+}
@@ -0,0 +1,101 @@
+/**
+ * EnvShared.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define ENV_SHM_MAGIC "C8EV"
+#define ENV_SHM_VERSION 2
+
+// Result slots; a step's results stay readable until ENV_RING_SLOTS more commands have run
+#define ENV_RING_SLOTS 4
+
+// Polls of a sequence word before sleeping on its futex
+#define ENV_SPIN_COUNT 4096
+
+// Longest sleep on a futex before checking that the other process is still there
+#define ENV_POLL_MS 100
+
+// How long a client waits for the results of a command by default
+#define ENV_DEFAULT_TIMEOUT_MS 10000
+
+/* Commands */
+#define ENV_CMD_STEP 1
+#define ENV_CMD_RESET 2
+#define ENV_CMD_SHUTDOWN 3
+
+namespace c_plus_eight {
+	/**
+	 * Start of the shared region. The client fills in the actions and the
+	 * command, then bumps command_seq; the server runs it, writes the result
+	 * slot (command_seq % ENV_RING_SLOTS) and sets result_seq to the same
+	 * value. Both sequence words are futexes, so a side with nothing to do
+	 * sleeps in the kernel. Each side records its process id, so the other
+	 * can stop waiting when it exits.
+	 */
+	struct EnvSharedHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;             // environment instances
+		uint32_t action_count;      // valid action numbers are below this
+		uint64_t region_size;
+
+		alignas(64) std::atomic<uint32_t> command_seq;
+		uint32_t command;
+		uint64_t seed;              // ENV_CMD_RESET argument
+		uint32_t client_pid;        // 0 until a client connects
+
+		alignas(64) std::atomic<uint32_t> result_seq;
+		uint32_t server_pid;
+	};
+
+	/* Offsets of each part of the region for a given instance count */
+	struct EnvLayout {
+		size_t actions;         // uint32_t[count]
+		size_t ring;            // first result slot
+		size_t slot_size;
+
+		/* Within a result slot */
+		size_t observations;    // Framebuffer[count], 256 bytes each
+		size_t rewards;         // float[count]
+		size_t terminals;       // uint8_t[count]
+		size_t truncations;     // uint8_t[count]
+
+		size_t total;
+	};
+
+	inline size_t env_align64(size_t n)
+	{
+		return (n + 63) & ~(size_t)63;
+	}
+
+	inline EnvLayout env_layout(size_t count)
+	{
+		EnvLayout l;
+		l.actions = env_align64(sizeof(EnvSharedHeader));
+		l.ring = env_align64(l.actions + count * sizeof(uint32_t));
+
+		// each slot starts with the step number
+		l.observations = 64;
+		l.rewards = l.observations + count * 256;
+		l.terminals = env_align64(l.rewards + count * sizeof(float));
+		l.truncations = l.terminals + count;
+		l.slot_size = env_align64(l.truncations + count);
+
+		l.total = l.ring + ENV_RING_SLOTS * l.slot_size;
+		return l;
+	}
+
+	/* Sleep while *word == expected for at most ENV_POLL_MS, and wake all sleepers on word */
+	void env_futex_wait(std::atomic<uint32_t>* word, uint32_t expected);
+	void env_futex_wake(std::atomic<uint32_t>* word);
+
+	bool env_process_alive(uint32_t pid);
+	bool env_wait_change(std::atomic<uint32_t>* word, uint32_t last, uint32_t& now, uint32_t peer_pid,
+		uint32_t timeout_ms);
+}
@@ -0,0 +1,173 @@
+/**
+ * Environment.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include "Environment.h"
+#include "Hash.h"
+#include "Log.h"
+
+// Salts separating the episode seed and sticky-action streams
+#define EPISODE_SEED_SALT 0x3C6EF372FE94F82BULL
+#define STICKY_SALT 0xA54FF53A5F1D36F1ULL
+
+namespace c_plus_eight {
+	Environment::Environment(const Chip8& boot, const EnvConfig& config, size_t count)
+		: config(config), arena(boot, count)
+	{
+		if (this->config.actions.empty()) {
+			this->config.actions.push_back(0x0000);
+		} // end if (no actions)
+
+		this->last_action.resize(count);
+		this->score.resize(count);
+		this->episode.resize(count);
+		this->draws.resize(count);
+		this->episode_frames.resize(count);
+		this->episode_return.resize(count);
+		this->finished.resize(count);
+		this->rewards.resize(count);
+		this->terminals.resize(count);
+		this->truncations.resize(count);
+
+		this->reset(0);
+	}
+
+	// Score as stored by the ROM
+	uint64_t Environment::read_score(const Chip8& emu) const
+	{
+		const RewardSpec& r = this->config.reward;
+		uint64_t value = 0;
+		for (uint8_t b = 0; b < r.score_bytes; b++) {
+			uint8_t byte = emu.peek((uint16_t)(r.score_addr + b));
+			value = r.score_bcd ? (value * 10 + byte) : ((value << 8) | byte);
+		} // end for (b)
+		return value;
+	}
+
+	bool Environment::is_terminal(const Chip8& emu) const
+	{
+		const RewardSpec& r = this->config.reward;
+		return r.terminal_mask != 0 && (emu.peek(r.terminal_addr) & r.terminal_mask) == r.terminal_value;
+	}
+
+	// Uniform in [0, 1), the next draw of instance i's sticky-action stream
+	float Environment::next_uniform(size_t i)
+	{
+		uint64_t h = hash64_key(this->base_seed ^ STICKY_SALT, ((uint64_t)i << 40) ^ this->draws[i]++);
+		return (float)(h >> 40) / (float)(1 << 24);
+	}
+
+	// Put instance i back to the boot snapshot with this episode's seed
+	void Environment::begin_episode(size_t i)
+	{
+		this->arena.reset(i);
+		Chip8& emu = this->arena[i];
+		emu.seed(hash64_key(this->base_seed ^ EPISODE_SEED_SALT, ((uint64_t)i << 32) | this->episode[i]));
+
+		this->score[i] = this->read_score(emu);
+		this->last_action[i] = 0;
+		this->episode_frames[i] = 0;
+		this->episode_return[i] = 0.0f;
+		this->finished[i] = 0;
+	}
+
+	// Start a new episode on every instance and clear the statistics
+	void Environment::reset(uint64_t seed)
+	{
+		this->base_seed = seed;
+		this->stats = EpisodeStats();
+		for (size_t i = 0; i < this->size(); i++) {
+			this->episode[i] = 0;
+			this->draws[i] = 0;
+			this->rewards[i] = 0.0f;
+			this->terminals[i] = 0;
+			this->truncations[i] = 0;
+			this->begin_episode(i);
+		} // end for (i)
+	}
+
+	/**
+	 * Advance every instance frame_skip frames with actions[i] held on
+	 * instance i. Rewards, terminal and truncation flags of the step are in
+	 * get_rewards() etc.; with auto_reset, instances whose episode ended
+	 * have already started the next one. An instance that reaches an opcode
+	 * the core does not run ends its episode as terminal, counted in
+	 * EpisodeStats::faults; the other instances step on. Without auto_reset,
+	 * instances whose episode has ended stay put, with zero reward and their
+	 * done flags still set, until the next reset().
+	 */
+	void Environment::step(const uint32_t* actions)
+	{
+		const EnvConfig& c = this->config;
+		for (size_t i = 0; i < this->size(); i++) {
+			if (this->finished[i]) {
+				this->rewards[i] = 0.0f;
+				continue;
+			} // end if (finished)
+
+			Chip8& emu = this->arena[i];
+			uint32_t action = (actions[i] < c.actions.size()) ? actions[i] : 0;
+			float reward = 0.0f;
+			bool terminal = false;
+			bool truncated = false;
+
+			for (uint32_t k = 0; k < c.frame_skip && !terminal && !truncated; k++) {
+				uint32_t taken = action;
+				if (c.sticky_probability > 0.0f && this->next_uniform(i) < c.sticky_probability) {
+					taken = this->last_action[i];
+				} // end if (sticky)
+				this->last_action[i] = taken;
+
+				emu.set_keys(c.actions[taken]);
+				try {
+					emu.run_frame(c.cycles_per_frame);
+				}
+				catch (const machine_fault& e) {
+					LOG_WARN("Instance {} faulted at pc {:03X}: {}", i, emu.get_pc(), e.what());
+					this->stats.faults++;
+					terminal = true;
+					break;
+				} // end try
+				this->episode_frames[i]++;
+
+				uint64_t s = this->read_score(emu);
+				reward += (float)(int64_t)(s - this->score[i]) * c.reward.score_scale;
+				this->score[i] = s;
+
+				terminal = this->is_terminal(emu);
+				truncated = !terminal && c.max_episode_frames != 0 && this->episode_frames[i] >= c.max_episode_frames;
+			} // end for (k)
+
+			this->rewards[i] = reward;
+			this->terminals[i] = terminal ? 1 : 0;
+			this->truncations[i] = truncated ? 1 : 0;
+			this->episode_return[i] += reward;
+
+			if (terminal || truncated) {
+				this->stats.episodes++;
+				this->stats.frames += this->episode_frames[i];
+				this->stats.total_return += this->episode_return[i];
+				this->stats.last_return = this->episode_return[i];
+				this->stats.last_length = this->episode_frames[i];
+
+				if (c.auto_reset) {
+					this->episode[i]++;
+					this->begin_episode(i);
+				}
+				else {
+					this->finished[i] = 1;
+				} // end if (auto_reset)
+			} // end if (episode over)
+		} // end for (i)
+	}
+
+	ObservationView Environment::observations()
+	{
+		ObservationView view;
+		view.data = reinterpret_cast<const uint8_t*>(this->arena[0].get_graphics());
+		view.count = this->size();
+		view.stride = this->arena.stride();
+		return view;
+	}
+}
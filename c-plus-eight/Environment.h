@@ -0,0 +1,124 @@
+/**
+ * Environment.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+#include "InstanceArena.h"
+
+namespace c_plus_eight {
+	/**
+	 * Per-ROM reward and terminal rules, read from guest memory after every
+	 * frame. The score is a big-endian number (or BCD digits, one per byte, as
+	 * written by Fx33) at score_addr; the reward is its change times
+	 * score_scale. The episode ends when (memory[terminal_addr] & terminal_mask)
+	 * equals terminal_value.
+	 */
+	struct RewardSpec {
+		uint16_t score_addr = 0;
+		uint8_t score_bytes = 0;            // 0 = no score
+		bool score_bcd = false;
+		float score_scale = 1.0f;
+
+		uint16_t terminal_addr = 0;
+		uint8_t terminal_mask = 0;          // 0 = never terminal
+		uint8_t terminal_value = 0;
+	};
+
+	struct EnvConfig {
+		/* Keypad state (bit n = key n) for each action number */
+		std::vector<uint16_t> actions = { 0x0000 };
+
+		uint32_t frame_skip = 4;            // frames per step, the same action held throughout
+		float sticky_probability = 0.25f;   // chance per frame of repeating the previous action instead
+		uint32_t cycles_per_frame = 10;
+		uint32_t max_episode_frames = 108000;   // truncate after this many frames (0 = never)
+		bool auto_reset = true;
+
+		RewardSpec reward;
+	};
+
+	/* Totals over the episodes finished since the last reset() */
+	struct EpisodeStats {
+		uint64_t episodes = 0;
+		uint64_t frames = 0;
+		uint64_t faults = 0;                // episodes ended by a machine fault
+		double total_return = 0.0;
+		float last_return = 0.0f;
+		uint32_t last_length = 0;
+	};
+
+	/**
+	 * Framebuffers of every instance, in place: instance i's 32 rows (top row
+	 * first, bit 63 the leftmost pixel, as Chip8::get_graphics) start at
+	 * data + i * stride bytes. Valid for the environment's lifetime.
+	 */
+	struct ObservationView {
+		const uint8_t* data;
+		size_t count;
+		size_t stride;
+	};
+
+	/**
+	 * A batch of copies of one ROM driven as reinforcement-learning
+	 * environments. The instances live in an InstanceArena, so starting an
+	 * episode is a constant-time reset to the boot snapshot and stepping does
+	 * not allocate. Observations are the instances' own 1bpp framebuffers,
+	 * never copied. Needs only the emulator core.
+	 *
+	 * Sticky actions and episode seeds come from a counter-based generator
+	 * keyed by the reset() seed, so runs are reproducible.
+	 */
+	class Environment
+	{
+	private:
+		EnvConfig config;
+		InstanceArena arena;
+		uint64_t base_seed = 0;
+
+		/* Per instance */
+		std::vector<uint32_t> last_action;
+		std::vector<uint64_t> score;
+		std::vector<uint64_t> episode;
+		std::vector<uint64_t> draws;
+		std::vector<uint32_t> episode_frames;
+		std::vector<float> episode_return;
+		std::vector<uint8_t> finished;      // episode ended, waiting for reset() (without auto_reset)
+
+		/* Results of the last step() */
+		std::vector<float> rewards;
+		std::vector<uint8_t> terminals;
+		std::vector<uint8_t> truncations;
+
+		EpisodeStats stats;
+
+		uint64_t read_score(const Chip8& emu) const;
+		bool is_terminal(const Chip8& emu) const;
+		float next_uniform(size_t i);
+		void begin_episode(size_t i);
+
+	public:
+		Environment(const Chip8& boot, const EnvConfig& config, size_t count = 1);
+
+		void reset(uint64_t seed);
+		void step(const uint32_t* actions);
+
+		size_t size() const { return this->arena.size(); }
+		size_t action_count() const { return this->config.actions.size(); }
+
+		const Framebuffer& observation(size_t i) { return *this->arena[i].get_graphics(); }
+		ObservationView observations();
+		const Chip8& instance(size_t i) { return this->arena[i]; }
+
+		const float* get_rewards() const { return this->rewards.data(); }
+		const uint8_t* get_terminals() const { return this->terminals.data(); }
+		const uint8_t* get_truncations() const { return this->truncations.data(); }
+		const EpisodeStats& get_stats() const { return this->stats; }
+	};
+}
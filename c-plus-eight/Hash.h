@@ -0,0 +1,58 @@
+/**
+ * Hash.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+
+#define HASH64_SEED 0xCBF29CE484222325ULL
+#define MEMORY_HASH_SALT 0x6A09E667F3BCC908ULL
+#define GRAPHICS_HASH_SALT 0xBB67AE8584CAA73BULL
+
+namespace c_plus_eight {
+	// Finalizer from MurmurHash3, spreads every input bit over the whole word
+	inline uint64_t hash64_mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// Key of one (position, value) pair in a hash kept as the XOR of such keys
+	inline uint64_t hash64_key(uint64_t salt, uint64_t position)
+	{
+		return hash64_mix(salt ^ (position * 0x9E3779B97F4A7C15ULL));
+	}
+
+	/**
+	 * Non-cryptographic 64-bit hash of a byte range, consumed a word at a time.
+	 * Used for ROM identity and per-frame state hashes, not for anything an
+	 * attacker controls.
+	 */
+	inline uint64_t hash64(const void* data, size_t len, uint64_t h = HASH64_SEED)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		h ^= len;
+		for (; len >= 8; p += 8, len -= 8) {
+			uint64_t w;
+			memcpy(&w, p, 8);
+			h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+			h ^= h >> 29;
+		}
+
+		if (len > 0) {
+			uint64_t w = 0;
+			memcpy(&w, p, len);
+			h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+		}
+
+		return hash64_mix(h);
+	}
+}
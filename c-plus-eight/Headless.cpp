@@ -0,0 +1,245 @@
+// Headless.cpp : Command-line runner, runs a ROM at full speed without a window or audio.
+//
+// usage: c8run <rom> [--frames N] [--ipf N] [--quirks none|vip|schip|<flags>] [--seed N]
+//                    [--movie FILE] [--dump FILE] [--instances N]
+//
+// Prints the emulation speed and the final frame hash. With --movie, the movie's inputs are
+// played and its seed, quirks, instructions per frame and length are used. --dump writes every
+// frame's framebuffer (32 rows of 64 bits, top row first, bit 63 leftmost, host byte order).
+// --instances runs N copies in lockstep on one thread through LockstepScheduler, instance i
+// seeded with seed + i and all given the same input; dumps and hashes are of instance 0.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "Chip8.h"
+#include "Lockstep.h"
+#include "Movie.h"
+#include "Platform.h"
+
+// instructions executed per 60 Hz frame, as in the windowed build
+#define DEFAULT_CYCLES_PER_FRAME 10
+#define DEFAULT_FRAMES 600
+
+static void usage()
+{
+    fprintf(stderr, "usage: c8run <rom> [--frames N] [--ipf N] [--quirks none|vip|schip|<flags>] [--seed N]\n"
+        "                  [--movie FILE] [--dump FILE] [--instances N]\n");
+}
+
+// Named quirk profile or a number of QUIRK_* flags; returns false if unrecognised
+static bool parse_quirks(const char* text, uint8_t& quirks)
+{
+    if (strcmp(text, "none") == 0) {
+        quirks = 0;
+    }
+    else if (strcmp(text, "vip") == 0) {
+        quirks = QUIRK_SHIFT_VY | QUIRK_VF_RESET;
+    }
+    else if (strcmp(text, "schip") == 0) {
+        quirks = QUIRK_LOAD_STORE_I | QUIRK_JUMP_VX;
+    }
+    else {
+        char* end;
+        unsigned long flags = strtoul(text, &end, 0);
+        if (*end != '\0' || flags > 0xFF) {
+            return false;
+        }
+        quirks = (uint8_t)flags;
+    } // end if (text)
+    return true;
+}
+
+// Run copies of boot side by side in one LockstepScheduler
+static int run_lockstep(const c_plus_eight::Chip8& boot, uint32_t instances, uint32_t frames, uint32_t cycles_per_frame,
+    const c_plus_eight::MovieRecord* records, size_t record_count, FILE* dump)
+{
+    c_plus_eight::LockstepScheduler scheduler(boot, instances, cycles_per_frame);
+    for (uint32_t i = 0; i < instances; i++) {
+        scheduler.instance(i).seed(boot.get_seed() + i);
+    } // end for (i)
+
+    size_t next = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        if (next < record_count && records[next].frame <= frame) {
+            for (; next < record_count && records[next].frame <= frame; next++) {
+            } // end for (next)
+            for (uint32_t i = 0; i < instances; i++) {
+                scheduler.set_keys(i, records[next - 1].keys);
+            } // end for (i)
+        } // end if (keys changed)
+
+        scheduler.run_frame();
+        if (dump != NULL) {
+            fwrite(scheduler.instance(0).get_graphics()->data(), sizeof(c_plus_eight::Framebuffer), 1, dump);
+        } // end if (dump != NULL)
+    } // end for (frame)
+    scheduler.sync();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t cycles = 0;
+    uint64_t total_frames = 0;
+    for (uint32_t i = 0; i < instances; i++) {
+        cycles += scheduler.instance(i).get_cycles();
+        total_frames += scheduler.instance(i).get_frames();
+    } // end for (i)
+
+    const c_plus_eight::Chip8& first = scheduler.instance(0);
+    printf("instances   %u\n", instances);
+    printf("frames      %u\n", first.get_frames());
+    printf("cycles      %llu\n", (unsigned long long)cycles);
+    printf("seconds     %.6f\n", seconds);
+    printf("MIPS        %.2f\n", (seconds > 0) ? cycles / seconds / 1e6 : 0.0);
+    printf("FPS         %.0f\n", (seconds > 0) ? total_frames / seconds : 0.0);
+    printf("awake       %.1f%%\n", (frames > 0) ? 100.0 * scheduler.get_resumes() / ((double)frames * instances) : 0.0);
+    printf("faulted     %u\n", scheduler.get_faulted());
+    printf("frame hash  %016llx\n", (unsigned long long)first.frame_hash());
+    printf("state hash  %016llx\n", (unsigned long long)first.state_hash());
+    return (scheduler.get_faulted() == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* rom_path = NULL;
+    const char* movie_path = NULL;
+    const char* dump_path = NULL;
+    uint32_t frames = DEFAULT_FRAMES;
+    uint32_t cycles_per_frame = DEFAULT_CYCLES_PER_FRAME;
+    uint64_t seed = 0;
+    uint8_t quirks = 0;
+    uint32_t instances = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (arg[0] != '-') {
+            rom_path = arg;
+            continue;
+        }
+        if (value == NULL) {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp(arg, "--frames") == 0) {
+            frames = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--ipf") == 0) {
+            cycles_per_frame = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--seed") == 0) {
+            seed = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--quirks") == 0) {
+            if (!parse_quirks(value, quirks)) {
+                fprintf(stderr, "Unknown quirk profile '%s'.\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(arg, "--movie") == 0) {
+            movie_path = value;
+        }
+        else if (strcmp(arg, "--dump") == 0) {
+            dump_path = value;
+        }
+        else if (strcmp(arg, "--instances") == 0) {
+            instances = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else {
+            usage();
+            return EXIT_FAILURE;
+        } // end if (arg)
+        i++;
+    } // end for (i)
+
+    if (rom_path == NULL) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<c_plus_eight::Chip8> emu = std::make_unique<c_plus_eight::Chip8>(seed);
+    emu->set_quirks(quirks);
+    if (!emu->load_game(rom_path)) {
+        fprintf(stderr, "Could not load ROM '%s'.\n", rom_path);
+        return EXIT_FAILURE;
+    }
+
+    // a movie brings its own settings, the same way play_movie applies them
+    c_plus_eight::MovieReader movie;
+    const c_plus_eight::MovieRecord* records = NULL;
+    size_t record_count = 0;
+    if (movie_path != NULL) {
+        if (!movie.open(movie_path)) {
+            fprintf(stderr, "Could not open movie '%s'.\n", movie_path);
+            return EXIT_FAILURE;
+        }
+
+        const c_plus_eight::MovieHeader& h = movie.get_header();
+        if (h.rom_hash != emu->get_rom_hash()) {
+            fprintf(stderr, "Movie '%s' was recorded with a different ROM.\n", movie_path);
+            return EXIT_FAILURE;
+        }
+        emu->seed(h.seed);
+        emu->set_quirks(h.quirks);
+        cycles_per_frame = h.cycles_per_frame;
+        frames = h.frame_count;
+        records = movie.get_records();
+        record_count = movie.record_count();
+    } // end if (movie_path != NULL)
+
+    FILE* dump = NULL;
+    if (dump_path != NULL) {
+        fopen_s(&dump, dump_path, "wb");
+        if (dump == NULL) {
+            fprintf(stderr, "Could not open '%s' for writing.\n", dump_path);
+            return EXIT_FAILURE;
+        }
+    } // end if (dump_path != NULL)
+
+    if (instances > 0) {
+        int status = run_lockstep(*emu, instances, frames, cycles_per_frame, records, record_count, dump);
+        if (dump != NULL) {
+            fclose(dump);
+        }
+        return status;
+    } // end if (instances > 0)
+
+    int status = EXIT_SUCCESS;
+    size_t next = 0;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            for (; next < record_count && records[next].frame <= frame; next++) {
+                emu->set_keys(records[next].keys);
+            } // end for (next)
+
+            emu->run_frame(cycles_per_frame);
+            if (dump != NULL) {
+                fwrite(emu->get_graphics()->data(), sizeof(c_plus_eight::Framebuffer), 1, dump);
+            } // end if (dump != NULL)
+        } // end for (frame)
+    }
+    catch (c_plus_eight::machine_fault& e) {
+        fprintf(stderr, "%s (pc %03X, frame %u)\n", e.what(), emu->get_pc(), emu->get_frames());
+        status = EXIT_FAILURE;
+    } // end try-catch
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (dump != NULL) {
+        fclose(dump);
+    }
+
+    // cycles include time spent halted on "LD Vx, K"
+    printf("frames      %u\n", emu->get_frames());
+    printf("cycles      %llu\n", (unsigned long long)emu->get_cycles());
+    printf("seconds     %.6f\n", seconds);
+    printf("MIPS        %.2f\n", (seconds > 0) ? emu->get_cycles() / seconds / 1e6 : 0.0);
+    printf("FPS         %.0f\n", (seconds > 0) ? emu->get_frames() / seconds : 0.0);
+    printf("frame hash  %016llx\n", (unsigned long long)emu->frame_hash());
+    printf("state hash  %016llx\n", (unsigned long long)emu->state_hash());
+    return status;
+}
@@ -0,0 +1,149 @@
+// Indexer.cpp : Builds and lists ROM indexes for the ROM browser.
+//
+// usage: c8index <rom directory> [--out FILE] [--frames N] [--ipf N] [--threads N]
+//        c8index --list FILE [--thumbnails]
+//
+// Building reuses the entries of an existing index at --out for files that have not changed, so
+// re-indexing a directory only reads the new and modified ROMs.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "RomIndex.h"
+
+#define DEFAULT_INDEX_PATH "roms.c8ix"
+
+static void usage()
+{
+    fprintf(stderr, "usage: c8index <rom directory> [--out FILE] [--frames N] [--ipf N] [--threads N]\n"
+        "       c8index --list FILE [--thumbnails]\n");
+}
+
+static const char* variant_name(uint8_t variant)
+{
+    switch (variant) {
+    case ROM_VARIANT_SCHIP:
+        return "SCHIP";
+    case ROM_VARIANT_XOCHIP:
+        return "XO-CHIP";
+    default:
+        return "CHIP-8";
+    } // end switch (variant)
+}
+
+// Thumbnail at half size, one character per 2x2 block of pixels
+static void print_thumbnail(const c_plus_eight::Framebuffer& pixels)
+{
+    for (size_t row = 0; row < SCREEN_ROWS; row += 2) {
+        uint64_t lit = pixels[row] | pixels[row + 1];
+        char line[SCREEN_COLS / 2 + 1];
+        for (size_t col = 0; col < SCREEN_COLS / 2; col++) {
+            line[col] = ((lit >> (62 - 2 * col)) & 0x3) ? '#' : ' ';
+        } // end for (col)
+        line[SCREEN_COLS / 2] = '\0';
+        printf("    |%s|\n", line);
+    } // end for (row)
+}
+
+static int list(const char* index_path, bool thumbnails)
+{
+    auto start = std::chrono::steady_clock::now();
+    c_plus_eight::RomIndex index;
+    if (!index.open(index_path)) {
+        fprintf(stderr, "Could not open ROM index '%s'.\n", index_path);
+        return EXIT_FAILURE;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < index.size(); i++) {
+        const c_plus_eight::RomIndexEntry& e = index.entry(i);
+        printf("%-16s %6u  %016llx  %-7s  quirks %X  features %04X%s%s%s%s\n", index.name(e), e.size,
+            (unsigned long long)e.rom_hash, variant_name(e.variant), e.quirks, e.features,
+            (e.flags & ROM_FLAG_FAULTED) ? "  faulted" : "", (e.flags & ROM_FLAG_WAITS_FOR_KEY) ? "  waits-for-key" : "",
+            (e.flags & ROM_FLAG_SOUND) ? "  sound" : "", (e.flags & ROM_FLAG_TOO_LARGE) ? "  too-large" : "");
+        if (thumbnails) {
+            print_thumbnail(e.thumbnail);
+        } // end if (thumbnails)
+    } // end for (i)
+
+    printf("%zu ROMs, opened in %.3f ms\n", index.size(), ms);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* directory = NULL;
+    const char* index_path = DEFAULT_INDEX_PATH;
+    const char* list_path = NULL;
+    bool thumbnails = false;
+    uint32_t frames = ROM_INDEX_DEFAULT_FRAMES;
+    uint32_t cycles_per_frame = ROM_INDEX_DEFAULT_CYCLES_PER_FRAME;
+    unsigned int threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (arg[0] != '-') {
+            directory = arg;
+            continue;
+        }
+        if (strcmp(arg, "--thumbnails") == 0) {
+            thumbnails = true;
+            continue;
+        }
+        if (value == NULL) {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp(arg, "--out") == 0) {
+            index_path = value;
+        }
+        else if (strcmp(arg, "--list") == 0) {
+            list_path = value;
+        }
+        else if (strcmp(arg, "--frames") == 0) {
+            frames = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--ipf") == 0) {
+            cycles_per_frame = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            threads = (unsigned int)strtoul(value, NULL, 0);
+        }
+        else {
+            usage();
+            return EXIT_FAILURE;
+        } // end if (arg)
+        i++;
+    } // end for (i)
+
+    if (list_path != NULL) {
+        return list(list_path, thumbnails);
+    }
+    if (directory == NULL) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    // an index built with other run settings has other thumbnails, so start over
+    c_plus_eight::RomIndex previous;
+    bool have_previous = previous.open(index_path) && previous.get_header().frames == frames
+        && previous.get_header().cycles_per_frame == cycles_per_frame;
+    if (!have_previous) {
+        previous.close();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    c_plus_eight::RomIndexer indexer(frames, cycles_per_frame, threads);
+    if (!indexer.build(directory, index_path, have_previous ? &previous : NULL)) {
+        fprintf(stderr, "Could not index '%s' into '%s'.\n", directory, index_path);
+        return EXIT_FAILURE;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu ROMs indexed, %zu unchanged, in %.1f ms -> %s\n", indexer.get_indexed(), indexer.get_reused(), ms, index_path);
+    return EXIT_SUCCESS;
+}
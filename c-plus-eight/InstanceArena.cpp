@@ -0,0 +1,117 @@
+/**
+ * InstanceArena.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <new>
+
+#include "InstanceArena.h"
+#include "Log.h"
+
+namespace c_plus_eight {
+	// Map length bytes, preferably in huge pages; sets huge if they were granted
+	static uint8_t* map_arena(size_t length, bool& huge)
+	{
+		void* p = NULL;
+		huge = false;
+
+#ifdef _WIN32
+		// needs the "Lock pages in memory" privilege, otherwise falls back to normal pages
+		SIZE_T large = GetLargePageMinimum();
+		if (large != 0 && length % large == 0) {
+			p = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			huge = (p != NULL);
+		} // end if (large != 0)
+
+		if (p == NULL) {
+			p = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		} // end if (p == NULL)
+#else
+#ifdef MAP_HUGETLB
+		// explicit huge pages, if the administrator has reserved any
+		p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p == MAP_FAILED) {
+			p = NULL;
+		}
+		huge = (p != NULL);
+#endif
+
+		if (p == NULL) {
+			p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED) {
+				p = NULL;
+			}
+#ifdef MADV_HUGEPAGE
+			// otherwise ask for transparent huge pages
+			else {
+				madvise(p, length, MADV_HUGEPAGE);
+			}
+#endif
+		} // end if (p == NULL)
+#endif
+
+		return static_cast<uint8_t*>(p);
+	}
+
+	static void unmap_arena(uint8_t* p, size_t length)
+	{
+#ifdef _WIN32
+		(void)length;
+		VirtualFree(p, 0, MEM_RELEASE);
+#else
+		munmap(p, length);
+#endif
+	}
+
+	InstanceArena::InstanceArena(const Chip8& boot, size_t count)
+		: boot(boot), count(count)
+	{
+		size_t bytes = count * sizeof(Slot);
+		this->length = (bytes + ARENA_HUGE_PAGE_SIZE - 1) / ARENA_HUGE_PAGE_SIZE * ARENA_HUGE_PAGE_SIZE;
+		if (this->length == 0) {
+			this->length = ARENA_HUGE_PAGE_SIZE;
+		} // end if (length == 0)
+
+		this->base = map_arena(this->length, this->huge);
+		if (this->base == NULL) {
+			LOG_ERROR("Could not map {} bytes for {} instances.", this->length, count);
+			throw std::bad_alloc();
+		} // end if (base == NULL)
+
+		for (size_t i = 0; i < count; i++) {
+			Slot* s = new (this->base + i * sizeof(Slot)) Slot(boot);
+			for (MemoryPage& page : s->spare) {
+				page.refs.store(0, std::memory_order_relaxed);
+				page.pooled = true;
+			}
+			s->machine.page_pool = s->spare;
+		} // end for (i)
+	}
+
+	InstanceArena::~InstanceArena()
+	{
+		for (size_t i = 0; i < this->count; i++) {
+			this->slot(i).~Slot();
+		}
+		unmap_arena(this->base, this->length);
+	}
+
+	// Put a machine back to the boot snapshot; its spare pages become free again
+	void InstanceArena::reset(size_t i)
+	{
+		this->slot(i).machine = this->boot;
+	}
+
+	void InstanceArena::reset_all()
+	{
+		for (size_t i = 0; i < this->count; i++) {
+			this->reset(i);
+		}
+	}
+}
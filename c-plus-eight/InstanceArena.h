@@ -0,0 +1,63 @@
+/**
+ * InstanceArena.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Chip8.h"
+#include "MemoryPage.h"
+
+// Size the arena is rounded up to, one x86-64 huge page
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+namespace c_plus_eight {
+	/**
+	 * Many machines booted from one snapshot, laid out at a fixed stride in a
+	 * single huge-page-backed mapping. Each slot holds the machine and a spare
+	 * page for each of its memory pages, so writes that break copy-on-write
+	 * sharing with the snapshot land in the slot instead of the heap; after
+	 * construction, running and resetting machines does not allocate.
+	 *
+	 * reset() copies the snapshot's registers back and re-shares its pages,
+	 * which costs the same however much the machine had written.
+	 *
+	 * Machines cloned from an arena slot may share its spare pages and must
+	 * not outlive the arena.
+	 */
+	class InstanceArena
+	{
+	private:
+		struct alignas(64) Slot {
+			Chip8 machine;
+			MemoryPage spare[MEMORY_PAGES];
+
+			Slot(const Chip8& boot) : machine(boot) {}
+		};
+
+		Chip8 boot;
+		uint8_t* base = NULL;
+		size_t length = 0;
+		size_t count;
+		bool huge = false;
+
+		Slot& slot(size_t i) { return *reinterpret_cast<Slot*>(this->base + i * sizeof(Slot)); }
+
+	public:
+		InstanceArena(const Chip8& boot, size_t count);
+		InstanceArena(const InstanceArena&) = delete;
+		InstanceArena& operator=(const InstanceArena&) = delete;
+		~InstanceArena();
+
+		Chip8& operator[](size_t i) { return this->slot(i).machine; }
+		void reset(size_t i);
+		void reset_all();
+
+		size_t size() const { return this->count; }
+		size_t stride() const { return sizeof(Slot); }
+		bool is_huge_backed() const { return this->huge; }
+	};
+}
@@ -0,0 +1,70 @@
+/**
+ * Latency.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <algorithm>
+#include "Latency.h"
+#include "spdlog/spdlog.h"
+
+namespace c_plus_eight {
+	static const char* stage_names[] = { "received", "applied", "read", "drawn", "presented" };
+
+	// Stamp every event up to and including last_id that has not reached this stage yet
+	void LatencyTracker::stamp(LatencyStage stage, uint32_t last_id, uint64_t now)
+	{
+		uint32_t& done = this->stamped[(int)stage];
+		if (last_id <= done) {
+			return;
+		} // end if (last_id <= done)
+
+		if (this->records.size() < last_id) {
+			this->records.resize(last_id, Record{});
+		} // end if (records.size() < last_id)
+
+		for (uint32_t id = done + 1; id <= last_id; id++) {
+			this->records[id - 1].t[(int)stage] = now;
+		} // end for (id)
+
+		done = last_id;
+	}
+
+	// Log p50/p99 of each stage-to-stage delay and of the whole path
+	void LatencyTracker::report() const
+	{
+		static const LatencyStage spans[][2] = {
+			{ LatencyStage::Received, LatencyStage::Applied },
+			{ LatencyStage::Applied, LatencyStage::Read },
+			{ LatencyStage::Read, LatencyStage::Drawn },
+			{ LatencyStage::Drawn, LatencyStage::Presented },
+			{ LatencyStage::Received, LatencyStage::Presented }
+		};
+
+		std::vector<double> ms;
+		ms.reserve(this->records.size());
+
+		spdlog::get("logger")->info("Input latency over {} events:", this->records.size());
+		for (const auto& span : spans) {
+			int from = (int)span[0];
+			int to = (int)span[1];
+
+			// only events that reached both stages count
+			ms.clear();
+			for (const Record& rec : this->records) {
+				if (rec.t[from] != 0 && rec.t[to] != 0) {
+					ms.push_back((rec.t[to] - rec.t[from]) * 1000.0 / this->ticks_per_second);
+				}
+			} // end for (rec)
+
+			if (ms.empty()) {
+				continue;
+			} // end if (ms.empty())
+
+			std::sort(ms.begin(), ms.end());
+			double p50 = ms[(ms.size() - 1) / 2];
+			double p99 = ms[((ms.size() - 1) * 99) / 100];
+			spdlog::get("logger")->info("  {:>9} -> {:<9}  p50 {:7.3f} ms  p99 {:7.3f} ms  (n={})",
+				stage_names[from], stage_names[to], p50, p99, ms.size());
+		} // end for (span)
+	}
+}
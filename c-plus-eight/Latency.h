@@ -0,0 +1,46 @@
+/**
+ * Latency.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace c_plus_eight {
+	/* Stages an input event passes through on its way to the screen */
+	enum class LatencyStage {
+		Received = 0,   // dequeued by the host
+		Applied,        // passed to key_press/key_release
+		Read,           // first read by SKP/SKNP/LD Vx, K
+		Drawn,          // first DRW that changed pixels afterwards
+		Presented,      // first buffer swap showing that DRW
+		Count
+	};
+
+	/**
+	 * Collects per-event timestamps for the input-to-photon path and reports
+	 * p50/p99 for each stage at the end of a session. Event ids are the
+	 * sequence numbers handed out by Chip8::key_press/key_release.
+	 */
+	class LatencyTracker
+	{
+	private:
+		struct Record {
+			uint64_t t[(int)LatencyStage::Count];
+		};
+
+		uint64_t ticks_per_second = 1;
+		std::vector<Record> records;
+
+		/* Highest event id already stamped for each stage */
+		uint32_t stamped[(int)LatencyStage::Count] = {};
+
+	public:
+		LatencyTracker(uint64_t tps): ticks_per_second(tps) {}
+
+		void stamp(LatencyStage stage, uint32_t last_id, uint64_t now);
+		void report() const;
+	};
+}
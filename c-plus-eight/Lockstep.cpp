@@ -0,0 +1,142 @@
+/**
+ * Lockstep.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include "Lockstep.h"
+
+#ifdef __cpp_impl_coroutine
+
+#include "Log.h"
+
+namespace c_plus_eight {
+	LockstepScheduler::LockstepScheduler(const Chip8& boot, size_t count, uint32_t cycles_per_frame)
+		: arena(boot, count), cycles_per_frame(cycles_per_frame)
+	{
+		this->tasks.reserve(count);
+		this->state.resize(count, INSTANCE_RUNNING);
+		this->asleep_since.resize(count, 0);
+		this->next.reserve(count);
+		this->running.reserve(count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			this->tasks.push_back(this->run_instance(i).handle);
+			this->next.push_back(i);
+		} // end for (i)
+	}
+
+	LockstepScheduler::~LockstepScheduler()
+	{
+		for (auto task : this->tasks) {
+			task.destroy();
+		} // end for (task)
+	}
+
+	// Body of every instance: one frame per resume, sleeping through idle stretches
+	LockstepScheduler::Task LockstepScheduler::run_instance(uint32_t i)
+	{
+		Chip8& emu = this->arena[i];
+		for (;;) {
+			if (emu.is_waiting_for_key()) {
+				co_await KeyPress{ this, i };
+			}
+			else if (uint8_t frames = emu.delay_wait_frames(this->cycles_per_frame)) {
+				co_await TimerExpiry{ this, i, frames };
+			} // end if (idle)
+
+			try {
+				emu.run_frame(this->cycles_per_frame);
+			}
+			catch (const machine_fault& e) {
+				LOG_WARN("Instance {} faulted at pc {:03X}: {}", i, emu.get_pc(), e.what());
+				this->state[i] = INSTANCE_FAULTED;
+				this->faulted++;
+				co_return;
+			} // end try
+
+			co_await FrameBoundary{ this, i };
+		} // end for (;;)
+	}
+
+	void LockstepScheduler::TimerExpiry::await_suspend(std::coroutine_handle<>) const
+	{
+		this->scheduler->sleep(this->i, INSTANCE_TIMER_WAIT);
+		this->scheduler->wheel[(this->scheduler->frame + this->frames) % LOCKSTEP_WHEEL_SIZE].push_back(this->i);
+	}
+
+	void LockstepScheduler::sleep(uint32_t i, InstanceState why)
+	{
+		this->state[i] = why;
+		this->asleep_since[i] = this->frame;
+		this->sleeping++;
+	}
+
+	// Skip a sleeping instance over the frames it missed
+	void LockstepScheduler::catch_up(uint32_t i)
+	{
+		this->arena[i].skip_frames(this->frame - this->asleep_since[i], this->cycles_per_frame);
+		this->asleep_since[i] = this->frame;
+	}
+
+	// Run every awake instance for one frame
+	void LockstepScheduler::run_frame()
+	{
+		std::vector<uint32_t>& due = this->wheel[this->frame % LOCKSTEP_WHEEL_SIZE];
+		for (uint32_t i : due) {
+			this->catch_up(i);
+			this->state[i] = INSTANCE_RUNNING;
+			this->sleeping--;
+			this->next.push_back(i);
+		} // end for (i)
+		due.clear();
+
+		this->running.swap(this->next);
+		this->next.clear();
+		for (uint32_t i : this->running) {
+			this->tasks[i].resume();
+		} // end for (i)
+		this->resumes += this->running.size();
+
+		this->frame++;
+	}
+
+	void LockstepScheduler::run_frames(uint32_t frames)
+	{
+		for (uint32_t f = 0; f < frames; f++) {
+			this->run_frame();
+		} // end for (f)
+	}
+
+	// Keypad state for instance i from the next frame on; a new key press wakes it from "LD Vx, K"
+	void LockstepScheduler::set_keys(uint32_t i, uint16_t keys)
+	{
+		Chip8& emu = this->arena[i];
+		if (this->state[i] == INSTANCE_KEY_WAIT && (keys & ~emu.get_keys()) != 0) {
+			this->catch_up(i);
+			this->state[i] = INSTANCE_RUNNING;
+			this->sleeping--;
+			this->next.push_back(i);
+		} // end if (woken)
+		emu.set_keys(keys);
+	}
+
+	// Bring every sleeping instance up to date, e.g. before reading them all
+	void LockstepScheduler::sync()
+	{
+		for (uint32_t i = 0; i < this->state.size(); i++) {
+			if (this->state[i] == INSTANCE_KEY_WAIT || this->state[i] == INSTANCE_TIMER_WAIT) {
+				this->catch_up(i);
+			} // end if (asleep)
+		} // end for (i)
+	}
+
+	Chip8& LockstepScheduler::instance(uint32_t i)
+	{
+		if (this->state[i] == INSTANCE_KEY_WAIT || this->state[i] == INSTANCE_TIMER_WAIT) {
+			this->catch_up(i);
+		} // end if (asleep)
+		return this->arena[i];
+	}
+}
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * Lockstep.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+// Needs C++20 coroutines; compiled out in C++17 builds
+#ifdef __cpp_impl_coroutine
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+#include "InstanceArena.h"
+
+// Delay timer waits are at most 255 frames, so a 256-frame timer wheel never wraps onto itself
+#define LOCKSTEP_WHEEL_SIZE 256
+
+namespace c_plus_eight {
+	/**
+	 * Many copies of one ROM run a frame at a time on the calling thread,
+	 * each as a coroutine that suspends at every frame boundary. An instance
+	 * that halts on "LD Vx, K" suspends until set_keys() presses a key, and
+	 * one spinning in a "LD Vx, DT / SE Vx, 0 / JP" loop suspends until its
+	 * delay timer runs out; while asleep it is not resumed at all, and on
+	 * waking Chip8::skip_frames() brings it up to date in constant time. The
+	 * result is identical to calling run_frame() on every instance each frame.
+	 *
+	 * Instances live in an InstanceArena. A fault (unknown opcode or stack
+	 * error) stops only that instance. Not thread-safe; use one scheduler per
+	 * thread.
+	 */
+	class LockstepScheduler
+	{
+	public:
+		/* Coroutine running one instance */
+		class Task
+		{
+		public:
+			struct promise_type {
+				Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				std::suspend_always final_suspend() noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { throw; }
+			};
+
+			explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+			std::coroutine_handle<promise_type> handle;
+		};
+
+	private:
+		enum InstanceState : uint8_t {
+			INSTANCE_RUNNING,
+			INSTANCE_KEY_WAIT,
+			INSTANCE_TIMER_WAIT,
+			INSTANCE_FAULTED
+		};
+
+		/* Suspends the calling instance until the given kind of wake-up */
+		struct FrameBoundary {
+			LockstepScheduler* scheduler;
+			uint32_t i;
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<>) const { this->scheduler->next.push_back(this->i); }
+			void await_resume() const noexcept {}
+		};
+
+		struct KeyPress {
+			LockstepScheduler* scheduler;
+			uint32_t i;
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<>) const { this->scheduler->sleep(this->i, INSTANCE_KEY_WAIT); }
+			void await_resume() const noexcept {}
+		};
+
+		struct TimerExpiry {
+			LockstepScheduler* scheduler;
+			uint32_t i;
+			uint8_t frames;
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<>) const;
+			void await_resume() const noexcept {}
+		};
+
+		InstanceArena arena;
+		uint32_t cycles_per_frame;
+		uint32_t frame = 0;
+
+		std::vector<std::coroutine_handle<Task::promise_type>> tasks;
+		std::vector<InstanceState> state;
+		std::vector<uint32_t> asleep_since;     // frame an instance went to sleep on
+
+		/* Instances to resume in the coming frame, and those queued for the one after */
+		std::vector<uint32_t> next;
+		std::vector<uint32_t> running;
+		std::array<std::vector<uint32_t>, LOCKSTEP_WHEEL_SIZE> wheel;
+
+		uint32_t sleeping = 0;
+		uint32_t faulted = 0;
+		uint64_t resumes = 0;
+
+		Task run_instance(uint32_t i);
+		void sleep(uint32_t i, InstanceState why);
+		void catch_up(uint32_t i);
+
+	public:
+		LockstepScheduler(const Chip8& boot, size_t count, uint32_t cycles_per_frame);
+		LockstepScheduler(const LockstepScheduler&) = delete;
+		LockstepScheduler& operator=(const LockstepScheduler&) = delete;
+		~LockstepScheduler();
+
+		void run_frame();
+		void run_frames(uint32_t frames);
+		void set_keys(uint32_t i, uint16_t keys);
+		void sync();
+
+		/* Instance i, brought up to date first if it is asleep */
+		Chip8& instance(uint32_t i);
+
+		size_t size() const { return this->tasks.size(); }
+		uint32_t get_frame() const { return this->frame; }
+		bool is_faulted(uint32_t i) const { return this->state[i] == INSTANCE_FAULTED; }
+		uint32_t get_sleeping() const { return this->sleeping; }
+		uint32_t get_faulted() const { return this->faulted; }
+		uint64_t get_resumes() const { return this->resumes; }
+	};
+}
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * Log.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+/*
+ * Logging for the emulator core. The application logs through spdlog's
+ * "logger"; builds that embed the core without spdlog (the C library)
+ * define C8_NO_SPDLOG, log nothing and rely on return values instead.
+ */
+#ifdef C8_NO_SPDLOG
+#define LOG_DEBUG(...) ((void)0)
+#define LOG_INFO(...) ((void)0)
+#define LOG_WARN(...) ((void)0)
+#define LOG_ERROR(...) ((void)0)
+#else
+#include "spdlog/spdlog.h"
+#define LOG_DEBUG(...) spdlog::get("logger")->debug(__VA_ARGS__)
+#define LOG_INFO(...) spdlog::get("logger")->info(__VA_ARGS__)
+#define LOG_WARN(...) spdlog::get("logger")->warn(__VA_ARGS__)
+#define LOG_ERROR(...) spdlog::get("logger")->error(__VA_ARGS__)
+#endif
@@ -0,0 +1,99 @@
+/**
+ * MappedFile.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+#include "Log.h"
+
+namespace c_plus_eight {
+	bool MappedFile::open(const char* file_path)
+	{
+		this->close();
+
+#ifdef _WIN32
+		HANDLE f = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (f == INVALID_HANDLE_VALUE) {
+			LOG_ERROR("Could not open file '{}'.", file_path);
+			return false;
+		} // end if (f == INVALID_HANDLE_VALUE)
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(f, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX) {
+			LOG_ERROR("Could not map file '{}'.", file_path);
+			CloseHandle(f);
+			return false;
+		} // end if (bad size)
+
+		HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+		const void* view = (m != NULL) ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (view == NULL) {
+			LOG_ERROR("Could not map file '{}'.", file_path);
+			if (m != NULL) {
+				CloseHandle(m);
+			}
+			CloseHandle(f);
+			return false;
+		} // end if (view == NULL)
+
+		this->file = f;
+		this->mapping = m;
+		this->base = static_cast<const uint8_t*>(view);
+		this->length = (size_t)size.QuadPart;
+#else
+		int fd = ::open(file_path, O_RDONLY);
+		if (fd < 0) {
+			LOG_ERROR("Could not open file '{}'.", file_path);
+			return false;
+		} // end if (fd < 0)
+
+		struct stat st;
+		void* view = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+
+		if (view == MAP_FAILED) {
+			LOG_ERROR("Could not map file '{}'.", file_path);
+			return false;
+		} // end if (view == MAP_FAILED)
+
+		// let the kernel read ahead aggressively and drop pages behind us
+		madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+		this->base = static_cast<const uint8_t*>(view);
+		this->length = (size_t)st.st_size;
+#endif
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (this->base == NULL) {
+			return;
+		} // end if (base == NULL)
+
+#ifdef _WIN32
+		UnmapViewOfFile(this->base);
+		CloseHandle(this->mapping);
+		CloseHandle(this->file);
+		this->mapping = NULL;
+		this->file = NULL;
+#else
+		munmap(const_cast<uint8_t*>(this->base), this->length);
+#endif
+		this->base = NULL;
+		this->length = 0;
+	}
+}
@@ -0,0 +1,74 @@
+/**
+ * MappedFile.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace c_plus_eight {
+	/**
+	 * Read-only memory mapping of a whole file, hinted for sequential access.
+	 * Movie and trace readers walk their fixed-size records directly in the
+	 * mapping, so once the page cache is warm replaying costs no I/O and no
+	 * parsing.
+	 */
+	class MappedFile
+	{
+	private:
+		const uint8_t* base = NULL;
+		size_t length = 0;
+#ifdef _WIN32
+		void* file = NULL;
+		void* mapping = NULL;
+#endif
+
+	public:
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { this->close(); }
+
+		bool open(const char* file_path);
+		void close();
+
+		const uint8_t* data() const { return this->base; }
+		size_t size() const { return this->length; }
+	};
+
+	/* Entry of the sparse frame index trailing movie and trace files */
+	struct FrameIndexEntry {
+		uint32_t frame;     // first frame covered by this entry
+		uint32_t reserved;
+		uint64_t record;    // index of the first record at or after frame
+	};
+
+	static_assert(sizeof(FrameIndexEntry) == 16, "FrameIndexEntry layout changed");
+
+	/**
+	 * Index of the first record stamped at or after frame, given an index with
+	 * one entry every interval frames. frame_of(i) returns the frame of record
+	 * i; only the records between two index entries are scanned. The index
+	 * comes from the file, so entries pointing past the records are clamped.
+	 */
+	template<typename FrameOf>
+	uint64_t seek_frame(const FrameIndexEntry* index, uint64_t index_count, uint32_t interval,
+		uint64_t record_count, uint32_t frame, FrameOf frame_of)
+	{
+		uint64_t i = 0;
+		if (index_count > 0) {
+			uint64_t slot = frame / interval;
+			i = index[(slot < index_count) ? slot : index_count - 1].record;
+			if (i > record_count) {
+				i = record_count;
+			} // end if (past the records)
+		} // end if (index_count > 0)
+
+		while (i < record_count && frame_of(i) < frame) {
+			i++;
+		}
+		return i;
+	}
+}
@@ -0,0 +1,49 @@
+/**
+ * MemoryPage.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define MEMORY_PAGE_SIZE 256
+#define MEMORY_PAGES 16
+
+namespace c_plus_eight {
+	/**
+	 * Reference-counted 256-byte block of guest memory. Cloned machines share
+	 * pages until one of them writes, at which point the writer takes a private
+	 * copy (see Chip8::page_for_write).
+	 *
+	 * Pooled pages belong to an InstanceArena slot: they are never deleted,
+	 * and a reference count of 0 means the page is free for reuse.
+	 */
+	struct MemoryPage {
+		std::atomic<uint32_t> refs{ 1 };
+		bool pooled = false;
+		uint8_t bytes[MEMORY_PAGE_SIZE] = {};
+
+		static MemoryPage* acquire(MemoryPage* p) {
+			p->refs.fetch_add(1, std::memory_order_relaxed);
+			return p;
+		}
+
+		static void release(MemoryPage* p) {
+			if (p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1 && !p->pooled) {
+				delete p;
+			}
+		}
+
+		// A page may only be written in place by its sole owner
+		bool is_shared() const {
+			return this->refs.load(std::memory_order_acquire) != 1;
+		}
+
+		// Pooled page nobody references any more
+		bool is_free() const {
+			return this->refs.load(std::memory_order_acquire) == 0;
+		}
+	};
+}
@@ -0,0 +1,217 @@
+/**
+ * Movie.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include "Movie.h"
+#include "Log.h"
+#include "Platform.h"
+
+namespace c_plus_eight {
+	Movie::Movie()
+	{
+		memset(&this->header, 0, sizeof(this->header));
+		memcpy(this->header.magic, MOVIE_MAGIC, 4);
+		this->header.version = MOVIE_VERSION;
+	}
+
+	// Start a new recording from a freshly loaded machine
+	void Movie::begin(const Chip8& emu, uint32_t cycles_per_frame)
+	{
+		this->header.rom_hash = emu.get_rom_hash();
+		this->header.seed = emu.get_seed();
+		this->header.cycles_per_frame = cycles_per_frame;
+		this->header.quirks = emu.get_quirks();
+		this->header.frame_count = emu.get_frames();
+		this->records.clear();
+	}
+
+	// Note the current keypad state, stored only if it changed since the last record
+	void Movie::record(const Chip8& emu)
+	{
+		uint32_t frame = emu.get_frames();
+		uint16_t keys = emu.get_keys();
+		uint16_t last = this->records.empty() ? 0 : this->records.back().keys;
+		if (keys != last) {
+			this->records.push_back({ frame, keys, 0 });
+		} // end if (keys != last)
+
+		if (frame > this->header.frame_count) {
+			this->header.frame_count = frame;
+		} // end if (frame > frame_count)
+	}
+
+	// Forget everything from frame onwards (after rewinding)
+	void Movie::truncate(uint32_t frame)
+	{
+		while (!this->records.empty() && this->records.back().frame >= frame) {
+			this->records.pop_back();
+		}
+		this->header.frame_count = frame;
+	}
+
+	bool Movie::save(const char* file_path) const
+	{
+		FILE* out;
+		fopen_s(&out, file_path, "wb");
+
+		if (out == NULL) {
+			LOG_ERROR("Could not open file '{}'.", file_path);
+			return false;
+		} // end if
+
+		// one index entry per MOVIE_INDEX_INTERVAL frames, pointing at the first record at or after it
+		std::vector<FrameIndexEntry> index;
+		for (uint32_t frame = 0; frame <= this->header.frame_count; frame += MOVIE_INDEX_INTERVAL) {
+			uint64_t first = std::lower_bound(this->records.begin(), this->records.end(), frame,
+				[](const MovieRecord& r, uint32_t f) { return r.frame < f; }) - this->records.begin();
+			index.push_back({ frame, 0, first });
+		} // end for (frame)
+
+		MovieHeader h = this->header;
+		h.record_count = (uint32_t)this->records.size();
+		h.index_count = (uint32_t)index.size();
+		h.index_interval = MOVIE_INDEX_INTERVAL;
+		bool ok = fwrite(&h, sizeof(h), 1, out) == 1
+			&& fwrite(this->records.data(), sizeof(MovieRecord), this->records.size(), out) == this->records.size()
+			&& fwrite(index.data(), sizeof(FrameIndexEntry), index.size(), out) == index.size();
+
+		fclose(out);
+		return ok;
+	}
+
+	bool Movie::load(const char* file_path)
+	{
+		FILE* in;
+		fopen_s(&in, file_path, "rb");
+
+		if (in == NULL) {
+			LOG_ERROR("Could not open file '{}'.", file_path);
+			return false;
+		} // end if
+
+		MovieHeader h;
+		if (fread(&h, sizeof(h), 1, in) != 1 || memcmp(h.magic, MOVIE_MAGIC, 4) != 0 || h.version != MOVIE_VERSION) {
+			LOG_ERROR("'{}' is not a version {} movie.", file_path, MOVIE_VERSION);
+			fclose(in);
+			return false;
+		} // end if (bad header)
+
+		// record_count comes from the file, so check it against the file's size before allocating
+		long header_end = ftell(in);
+		long size = (fseek(in, 0, SEEK_END) == 0) ? ftell(in) : -1;
+		if (header_end < 0 || size < header_end || fseek(in, header_end, SEEK_SET) != 0
+			|| (uint64_t)h.record_count * sizeof(MovieRecord) > (uint64_t)(size - header_end)) {
+			LOG_ERROR("Movie '{}' is truncated.", file_path);
+			fclose(in);
+			return false;
+		} // end if (size too small)
+
+		std::vector<MovieRecord> recs(h.record_count);
+		size_t got = fread(recs.data(), sizeof(MovieRecord), recs.size(), in);
+		fclose(in);
+
+		if (got != recs.size()) {
+			LOG_ERROR("Movie '{}' is truncated.", file_path);
+			return false;
+		} // end if (got != recs.size())
+
+		this->header = h;
+		this->records.swap(recs);
+		return true;
+	}
+
+	bool MovieReader::open(const char* file_path)
+	{
+		if (!this->file.open(file_path)) {
+			return false;
+		} // end if (!file.open)
+
+		const uint8_t* p = this->file.data();
+		size_t size = this->file.size();
+		const MovieHeader* h = reinterpret_cast<const MovieHeader*>(p);
+		if (size < sizeof(MovieHeader) || memcmp(h->magic, MOVIE_MAGIC, 4) != 0 || h->version != MOVIE_VERSION) {
+			LOG_ERROR("'{}' is not a version {} movie.", file_path, MOVIE_VERSION);
+			this->file.close();
+			return false;
+		} // end if (bad header)
+
+		size_t records_end = sizeof(MovieHeader) + (size_t)h->record_count * sizeof(MovieRecord);
+		if (size < records_end + (size_t)h->index_count * sizeof(FrameIndexEntry) || h->index_interval == 0) {
+			LOG_ERROR("Movie '{}' is truncated.", file_path);
+			this->file.close();
+			return false;
+		} // end if (size too small)
+
+		this->header = h;
+		this->records = reinterpret_cast<const MovieRecord*>(p + sizeof(MovieHeader));
+		this->index = reinterpret_cast<const FrameIndexEntry*>(p + records_end);
+		return true;
+	}
+
+	// Index of the first record applied at or after frame
+	size_t MovieReader::seek(uint32_t frame) const
+	{
+		return (size_t)seek_frame(this->index, this->header->index_count, this->header->index_interval,
+			this->header->record_count, frame, [this](uint64_t i) { return this->records[i].frame; });
+	}
+
+	/**
+	 * Replay a movie on a machine that has loaded the movie's ROM, from the
+	 * machine's current frame on (records before first are assumed to be
+	 * applied already). Key changes are fed through key_press/key_release
+	 * exactly as the host did, so the run is bit-identical to the recording.
+	 * If frame_hashes is given, Chip8::frame_hash() is appended after every
+	 * frame.
+	 */
+	bool play_movie(Chip8& emu, const MovieHeader& h, const MovieRecord* recs, size_t count,
+		size_t first, std::vector<uint64_t>* frame_hashes)
+	{
+		if (emu.get_rom_hash() != h.rom_hash) {
+			LOG_ERROR("Movie was recorded with a different ROM ({:016x}, loaded {:016x}).",
+				h.rom_hash, emu.get_rom_hash());
+			return false;
+		} // end if (rom_hash mismatch)
+
+		// starting from power-on, the movie supplies the seed and quirks
+		if (emu.get_frames() == 0) {
+			emu.seed(h.seed);
+			emu.set_quirks(h.quirks);
+		} // end if (get_frames() == 0)
+
+		if (frame_hashes != NULL) {
+			frame_hashes->reserve(frame_hashes->size() + h.frame_count);
+		} // end if (frame_hashes != NULL)
+
+		size_t next = first;
+		for (uint32_t frame = emu.get_frames(); frame < h.frame_count; frame++) {
+			for (; next < count && recs[next].frame <= frame; next++) {
+				emu.set_keys(recs[next].keys);
+			} // end for (next)
+
+			emu.run_frame(h.cycles_per_frame);
+			if (frame_hashes != NULL) {
+				frame_hashes->push_back(emu.frame_hash());
+			} // end if (frame_hashes != NULL)
+		} // end for (frame)
+
+		return true;
+	}
+
+	bool play_movie(Chip8& emu, const Movie& movie, std::vector<uint64_t>* frame_hashes)
+	{
+		const std::vector<MovieRecord>& recs = movie.get_records();
+		size_t first = std::lower_bound(recs.begin(), recs.end(), emu.get_frames(),
+			[](const MovieRecord& r, uint32_t f) { return r.frame < f; }) - recs.begin();
+		return play_movie(emu, movie.get_header(), recs.data(), recs.size(), first, frame_hashes);
+	}
+
+	bool play_movie(Chip8& emu, const MovieReader& movie, std::vector<uint64_t>* frame_hashes)
+	{
+		return play_movie(emu, movie.get_header(), movie.get_records(), movie.record_count(),
+			movie.seek(emu.get_frames()), frame_hashes);
+	}
+}
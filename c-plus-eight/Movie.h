@@ -0,0 +1,102 @@
+/**
+ * Movie.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+#include "MappedFile.h"
+
+namespace c_plus_eight {
+	/* File header of an input movie (host byte order) */
+	struct MovieHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t rom_hash;          // Chip8::get_rom_hash() of the recorded ROM
+		uint64_t seed;              // RNG seed at power-on
+		uint32_t cycles_per_frame;  // run_frame() argument used for every frame
+		uint8_t quirks;             // QUIRK_* flags
+		uint8_t reserved[3];
+		uint32_t frame_count;       // number of frames to play
+		uint32_t record_count;      // number of MovieRecords following the header
+		uint32_t index_count;       // number of FrameIndexEntries following the records
+		uint32_t index_interval;    // frames between index entries
+	};
+
+	/* Keypad state from a frame onwards, applied before that frame runs */
+	struct MovieRecord {
+		uint32_t frame;
+		uint16_t keys;
+		uint16_t reserved;
+	};
+
+	static_assert(sizeof(MovieHeader) == 48 && sizeof(MovieRecord) == 8, "movie layout changed");
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 2
+
+// frames between entries of the seek index written after the records
+#define MOVIE_INDEX_INTERVAL 1024
+
+	/**
+	 * Input movie: everything needed to replay a session from power-on. Only
+	 * keypad changes are stored, each stamped with the frame (timer tick) it
+	 * happened before, so a run of frames with the same keys costs nothing.
+	 * A frame may carry several records when keys were pressed and released
+	 * between two frames; they are replayed in order.
+	 */
+	class Movie
+	{
+	private:
+		MovieHeader header;
+		std::vector<MovieRecord> records;
+
+	public:
+		Movie();
+
+		/* Recording */
+
+		void begin(const Chip8& emu, uint32_t cycles_per_frame);
+		void record(const Chip8& emu);
+		void truncate(uint32_t frame);
+
+		/* Persistence */
+
+		bool save(const char* file_path) const;
+		bool load(const char* file_path);
+
+		const MovieHeader& get_header() const { return this->header; }
+		const std::vector<MovieRecord>& get_records() const { return this->records; }
+	};
+
+	/**
+	 * Movie file mapped into memory and read in place, for recordings too long
+	 * to load. Records are sorted by frame; seek() finds a frame through the
+	 * sparse index without touching the records before it.
+	 */
+	class MovieReader
+	{
+	private:
+		MappedFile file;
+		const MovieHeader* header = NULL;
+		const MovieRecord* records = NULL;
+		const FrameIndexEntry* index = NULL;
+
+	public:
+		bool open(const char* file_path);
+
+		const MovieHeader& get_header() const { return *this->header; }
+		const MovieRecord* get_records() const { return this->records; }
+		size_t record_count() const { return this->header->record_count; }
+		size_t seek(uint32_t frame) const;
+	};
+
+	bool play_movie(Chip8& emu, const MovieHeader& header, const MovieRecord* records, size_t count,
+		size_t first, std::vector<uint64_t>* frame_hashes);
+	bool play_movie(Chip8& emu, const Movie& movie, std::vector<uint64_t>* frame_hashes = NULL);
+	bool play_movie(Chip8& emu, const MovieReader& movie, std::vector<uint64_t>* frame_hashes = NULL);
+}
@@ -0,0 +1,17 @@
+/**
+ * Platform.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#ifndef _WIN32
+// The MSVC checked fopen the sources use, for POSIX builds
+inline int fopen_s(FILE** file, const char* path, const char* mode)
+{
+	*file = fopen(path, mode);
+	return (*file != NULL) ? 0 : 1;
+}
+#endif
@@ -73,13 +73,22 @@ namespace c_plus_eight {
 		return true;
 	}
 
-	void Renderer::draw(std::array<uint8_t, 32 * 64>* g)
+	void Renderer::draw(const std::array<uint64_t, 32>* g)
 	{
+		// expand the 1bpp rows, OpenGL wants the bottom row first
+		for (size_t row = 0; row < 32; row++) {
+			uint64_t bits = (*g)[row];
+			uint8_t* out = &this->pixels[(31 - row) * 64];
+			for (size_t col = 0; col < 64; col++) {
+				out[col] = ((bits >> (63 - col)) & 1) ? 0xFF : 0x00;
+			} // end for (col)
+		} // end for (row)
+
 		// clear framebuffer
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		// update pixel buffer
-		glDrawPixels(64, 32, GL_LUMINANCE, GL_UNSIGNED_BYTE, (void *)g);
+		glDrawPixels(64, 32, GL_LUMINANCE, GL_UNSIGNED_BYTE, (const void *)this->pixels.data());
 
 		// display OpenGL buffer on screen
 		SDL_GL_SwapWindow(this->game_window);
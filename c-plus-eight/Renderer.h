@@ -29,6 +29,9 @@ namespace c_plus_eight {
 		SDL_Window* game_window = NULL;
 		SDL_GLContext gl_ctx = NULL;
 
+		/* 1bpp framebuffer expanded to one luminance byte per pixel, bottom row first */
+		std::array<uint8_t, 32 * 64> pixels = {};
+
 		bool start_window();
 
 	public:
@@ -42,7 +45,7 @@ namespace c_plus_eight {
 			this->quit();
 		}
 
-		void draw(std::array<uint8_t, 32 * 64>* g);
+		void draw(const std::array<uint64_t, 32>* g);
 		void quit();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+/**
+ * Rewind.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <string.h>
+#include "Rewind.h"
+
+namespace c_plus_eight {
+	// Append a variable-length integer (7 bits per byte)
+	static uint8_t* put_varint(uint8_t* out, size_t v)
+	{
+		while (v >= 0x80) {
+			*out++ = (uint8_t)(v | 0x80);
+			v >>= 7;
+		}
+		*out++ = (uint8_t)v;
+		return out;
+	}
+
+	static const uint8_t* get_varint(const uint8_t* in, size_t& v)
+	{
+		v = 0;
+		for (int shift = 0; ; shift += 7) {
+			uint8_t b = *in++;
+			v |= (size_t)(b & 0x7F) << shift;
+			if ((b & 0x80) == 0) {
+				return in;
+			}
+		}
+	}
+
+	/**
+	 * Encode (a XOR b) as a sequence of [zero run][literal count][literals]
+	 * tokens. Zero runs are skipped a word at a time.
+	 */
+	static size_t encode_delta(const uint8_t* a, const uint8_t* b, size_t n, uint8_t* out)
+	{
+		uint8_t* p = out;
+		size_t i = 0;
+		while (i < n) {
+			// zero run
+			size_t start = i;
+			while (i + 8 <= n) {
+				uint64_t wa, wb;
+				memcpy(&wa, a + i, 8);
+				memcpy(&wb, b + i, 8);
+				if (wa != wb) {
+					break;
+				}
+				i += 8;
+			}
+			while (i < n && a[i] == b[i]) {
+				i++;
+			}
+
+			if (i == n) {
+				break;
+			}
+
+			// literal run, ended by at least four unchanged bytes
+			size_t lit = i;
+			while (i < n) {
+				if (a[i] == b[i] && (i + 4 > n || memcmp(a + i, b + i, 4) == 0)) {
+					break;
+				}
+				i++;
+			}
+
+			p = put_varint(p, lit - start);
+			p = put_varint(p, i - lit);
+			for (size_t j = lit; j < i; j++) {
+				*p++ = a[j] ^ b[j];
+			}
+		} // end while (i < n)
+
+		return p - out;
+	}
+
+	// XOR an encoded delta back into dst
+	static void apply_delta(const uint8_t* rec, size_t len, uint8_t* dst)
+	{
+		const uint8_t* end = rec + len;
+		size_t i = 0;
+		while (rec < end) {
+			size_t zeros, lit;
+			rec = get_varint(rec, zeros);
+			rec = get_varint(rec, lit);
+			i += zeros;
+			for (size_t j = 0; j < lit; j++) {
+				dst[i++] ^= *rec++;
+			}
+		}
+	}
+
+	RewindBuffer::RewindBuffer(size_t capacity)
+	{
+		this->data.resize(capacity);
+
+		// every byte a literal, plus the token headers
+		this->scratch.resize(sizeof(Chip8State) * 2 + 16);
+	}
+
+	// Record the next frame's snapshot
+	void RewindBuffer::push(const Chip8State& s)
+	{
+		if (this->has_head) {
+			size_t len = encode_delta(reinterpret_cast<const uint8_t*>(&this->head),
+				reinterpret_cast<const uint8_t*>(&s), sizeof(Chip8State), this->scratch.data());
+			this->store(this->scratch.data(), len);
+		} // end if (has_head)
+
+		this->head = s;
+		this->has_head = true;
+	}
+
+	// Step back one frame, returns false if there is nothing older to go back to
+	bool RewindBuffer::pop(Chip8State& out)
+	{
+		if (this->entries.empty()) {
+			return false;
+		} // end if (entries.empty())
+
+		Entry e = this->entries.back();
+		this->entries.pop_back();
+		apply_delta(&this->data[e.offset], e.length, reinterpret_cast<uint8_t*>(&this->head));
+		this->write_pos = e.offset;
+
+		out = this->head;
+		return true;
+	}
+
+	void RewindBuffer::clear()
+	{
+		this->entries.clear();
+		this->write_pos = 0;
+		this->has_head = false;
+	}
+
+	size_t RewindBuffer::bytes_used() const
+	{
+		size_t total = 0;
+		for (const Entry& e : this->entries) {
+			total += e.length;
+		}
+		return total;
+	}
+
+	// Copy an encoded delta into the ring, dropping the oldest ones it overwrites
+	void RewindBuffer::store(const uint8_t* rec, size_t len)
+	{
+		if (len > this->data.size()) {
+			this->entries.clear();
+			this->write_pos = 0;
+			return;
+		} // end if (len > data.size())
+
+		// wrap around; whatever sits past the write position is the oldest data
+		if (this->write_pos + len > this->data.size()) {
+			while (!this->entries.empty() && this->entries.front().offset >= this->write_pos) {
+				this->entries.pop_front();
+			}
+			this->write_pos = 0;
+		} // end if (wrap)
+
+		size_t end = this->write_pos + len;
+		while (!this->entries.empty()) {
+			const Entry& oldest = this->entries.front();
+			if (oldest.offset >= end || oldest.offset + oldest.length <= this->write_pos) {
+				break;
+			}
+			this->entries.pop_front();
+		} // end while (overlap)
+
+		memcpy(&this->data[this->write_pos], rec, len);
+		this->entries.push_back({ this->write_pos, len });
+		this->write_pos = end;
+	}
+}
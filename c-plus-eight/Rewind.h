@@ -0,0 +1,55 @@
+/**
+ * Rewind.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Chip8.h"
+
+namespace c_plus_eight {
+	/**
+	 * Ring of per-frame snapshots for rewinding. Only the newest snapshot is
+	 * kept whole; every older one is stored as the XOR delta against its
+	 * successor, compressed with zero-run encoding. Consecutive frames differ in
+	 * a handful of bytes, so a delta is typically a few dozen bytes. When the
+	 * ring is full the oldest deltas are dropped.
+	 */
+	class RewindBuffer
+	{
+	private:
+		struct Entry {
+			size_t offset;
+			size_t length;
+		};
+
+		/* Encoded deltas, oldest first */
+		std::vector<uint8_t> data;
+		std::deque<Entry> entries;
+		size_t write_pos = 0;
+
+		/* Newest snapshot */
+		Chip8State head;
+		bool has_head = false;
+
+		/* Worst-case sized buffer for encoding one delta */
+		std::vector<uint8_t> scratch;
+
+		void store(const uint8_t* rec, size_t len);
+
+	public:
+		RewindBuffer(size_t capacity = 4 * 1024 * 1024);
+
+		void push(const Chip8State& s);
+		bool pop(Chip8State& out);
+		void clear();
+
+		size_t frames() const { return this->entries.size(); }
+		size_t bytes_used() const;
+	};
+}
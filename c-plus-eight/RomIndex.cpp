@@ -0,0 +1,454 @@
+/**
+ * RomIndex.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Hash.h"
+#include "Log.h"
+#include "Platform.h"
+#include "RomIndex.h"
+
+namespace fs = std::filesystem;
+
+// ROMs load at 0x200 and may fill the rest of memory
+#define ROM_INDEX_CORE_MAX_SIZE (4096 - 0x200)
+
+namespace c_plus_eight {
+	/**
+	 * Follow the code from 0x200 through jumps, calls and both sides of every
+	 * skip, and return the ROM_FEATURE_* bits of the instructions reached.
+	 * Sprites and other data are never decoded unless the code runs into them.
+	 * Bnnn targets depend on V0, so paths end there.
+	 */
+	uint16_t scan_rom(const uint8_t* data, size_t len)
+	{
+		uint32_t end = 0x200 + (uint32_t)std::min<size_t>(len, ROM_INDEX_MAX_SIZE - 0x200);
+		auto fetch = [&](uint32_t addr) -> uint16_t {
+			return (addr >= 0x200 && addr + 1 < end) ? (uint16_t)((data[addr - 0x200] << 8) | data[addr - 0x200 + 1]) : 0;
+		};
+
+		uint16_t features = 0;
+		std::vector<bool> visited(ROM_INDEX_MAX_SIZE);
+		std::vector<uint32_t> pending = { 0x200 };
+		while (!pending.empty()) {
+			uint32_t addr = pending.back();
+			pending.pop_back();
+
+			// one path per address; a path leaving the ROM stops there
+			while (addr >= 0x200 && addr + 1 < end && !visited[addr]) {
+				visited[addr] = true;
+				uint16_t op = fetch(addr);
+				uint8_t x = OPCODE_X(op);
+				uint8_t y = OPCODE_Y(op);
+				uint8_t n = OPCODE_NIBBLE(op);
+				uint8_t kk = OPCODE_BYTE(op);
+				uint32_t next = addr + 2;
+
+				// XO-CHIP skips step over the 4-byte F000 nnnn as a whole
+				uint32_t skip = next + ((fetch(next) == 0xF000) ? 4 : 2);
+
+				bool valid = true;
+				bool falls_through = true;
+				switch (op & 0xF000) {
+				case 0x0000:
+					if (op == 0x00E0) {
+					}
+					else if (op == 0x00EE) {
+						falls_through = false;
+					}
+					else if ((op & 0xFFF0) == 0x00C0 || op == 0x00FB || op == 0x00FC) {
+						features |= ROM_FEATURE_SCROLL;
+					}
+					else if (op == 0x00FD) {
+						features |= ROM_FEATURE_EXIT;
+						falls_through = false;
+					}
+					else if (op == 0x00FE || op == 0x00FF) {
+						features |= ROM_FEATURE_HIRES;
+					}
+					else if ((op & 0xFFF0) == 0x00D0) {
+						features |= ROM_FEATURE_SCROLL_UP;
+					}
+					else {
+						// 0000 is padding; anything else calls 1802 machine code and returns
+						valid = op != 0x0000;
+						features |= valid ? ROM_FEATURE_SYS : 0;
+					} // end if (op)
+					break;
+				case 0x1000:
+					pending.push_back(OPCODE_ADDR(op));
+					falls_through = false;
+					break;
+				case 0x2000:
+					pending.push_back(OPCODE_ADDR(op));
+					break;
+				case 0x3000:
+				case 0x4000:
+					pending.push_back(skip);
+					break;
+				case 0x5000:
+				case 0x9000:
+					if (n == 0) {
+						pending.push_back(skip);
+					}
+					else if ((op & 0xF000) == 0x5000 && (n == 2 || n == 3)) {
+						features |= ROM_FEATURE_RANGE;
+					}
+					else {
+						valid = false;
+					} // end if (n)
+					break;
+				case 0x8000:
+					if (n == 0x6 || n == 0xE) {
+						features |= (x != y) ? ROM_FEATURE_SHIFT_XY : 0;
+					}
+					else {
+						valid = n <= 0x7;
+					} // end if (shift)
+					break;
+				case 0xB000:
+					features |= ROM_FEATURE_JUMP_OFFSET;
+					falls_through = false;
+					break;
+				case 0xD000:
+					features |= (n == 0) ? ROM_FEATURE_BIG_SPRITE : 0;
+					break;
+				case 0xE000:
+					if (kk == 0x9E || kk == 0xA1) {
+						pending.push_back(skip);
+					}
+					else {
+						valid = false;
+					} // end if (kk)
+					break;
+				case 0xF000:
+					if (op == 0xF000) {
+						features |= ROM_FEATURE_LONG_I;
+						next = addr + 4;
+					}
+					else if (op == 0xF002 || kk == 0x3A) {
+						features |= ROM_FEATURE_AUDIO;
+					}
+					else if (kk == 0x01) {
+						features |= ROM_FEATURE_PLANES;
+					}
+					else if (kk == 0x55 || kk == 0x65) {
+						features |= ROM_FEATURE_LOAD_STORE;
+					}
+					else if (kk == 0x30) {
+						features |= ROM_FEATURE_BIG_FONT;
+					}
+					else if (kk == 0x75 || kk == 0x85) {
+						features |= ROM_FEATURE_RPL_FLAGS;
+					}
+					else {
+						valid = kk == 0x07 || kk == 0x0A || kk == 0x15 || kk == 0x18 || kk == 0x1E || kk == 0x29 || kk == 0x33;
+					} // end if (op)
+					break;
+				default:
+					// 6xkk, 7xkk, Annn, Cxkk
+					break;
+				} // end switch (op & 0xF000)
+
+				if (!valid) {
+					features |= ROM_FEATURE_INVALID;
+					break;
+				} // end if (!valid)
+				if (!falls_through) {
+					break;
+				} // end if (!falls_through)
+				addr = next;
+			} // end while (addr in ROM)
+		} // end while (!pending.empty())
+
+		return features;
+	}
+
+	uint8_t guess_variant(uint16_t features)
+	{
+		if (features & ROM_FEATURES_XOCHIP) {
+			return ROM_VARIANT_XOCHIP;
+		}
+		if (features & ROM_FEATURES_SCHIP) {
+			return ROM_VARIANT_SCHIP;
+		}
+		return ROM_VARIANT_CHIP8;
+	}
+
+	/**
+	 * SCHIP programs expect its load/store and jump behaviour, XO-CHIP ones
+	 * shifts that read Vy. CHIP-8 programs get the VIP profile only when they
+	 * call 1802 machine code, so were written for the VIP itself; shifts
+	 * naming a second register are as often CHIP-48 era code that ignores it
+	 * (INVADERS, BLINKY) as VIP code that needs it.
+	 */
+	uint8_t guess_quirks(uint8_t variant, uint16_t features)
+	{
+		switch (variant) {
+		case ROM_VARIANT_SCHIP:
+			return QUIRK_LOAD_STORE_I | QUIRK_JUMP_VX;
+		case ROM_VARIANT_XOCHIP:
+			return QUIRK_SHIFT_VY;
+		default:
+			return (features & ROM_FEATURE_SYS) ? (QUIRK_SHIFT_VY | QUIRK_VF_RESET) : 0;
+		} // end switch (variant)
+	}
+
+	bool RomIndex::open(const char* file_path)
+	{
+		this->close();
+		if (!this->file.open(file_path)) {
+			return false;
+		} // end if (!file.open)
+
+		const uint8_t* p = this->file.data();
+		size_t size = this->file.size();
+		const RomIndexHeader* h = reinterpret_cast<const RomIndexHeader*>(p);
+		if (size < sizeof(RomIndexHeader) || memcmp(h->magic, ROM_INDEX_MAGIC, 4) != 0 || h->version != ROM_INDEX_VERSION
+			|| h->entry_size != sizeof(RomIndexEntry)) {
+			LOG_ERROR("'{}' is not a version {} ROM index.", file_path, ROM_INDEX_VERSION);
+			this->file.close();
+			return false;
+		} // end if (bad header)
+
+		size_t strings_start = sizeof(RomIndexHeader) + (size_t)h->entry_count * sizeof(RomIndexEntry);
+		const RomIndexEntry* entries = reinterpret_cast<const RomIndexEntry*>(p + sizeof(RomIndexHeader));
+		bool ok = size >= strings_start + h->strings_size && (h->strings_size == 0 || p[strings_start + h->strings_size - 1] == '\0');
+		for (uint32_t i = 0; ok && i < h->entry_count; i++) {
+			ok = entries[i].name_offset < h->strings_size;
+		} // end for (i)
+		if (!ok) {
+			LOG_ERROR("ROM index '{}' is truncated.", file_path);
+			this->file.close();
+			return false;
+		} // end if (!ok)
+
+		this->header = h;
+		this->entries = entries;
+		this->strings = reinterpret_cast<const char*>(p + strings_start);
+		return true;
+	}
+
+	void RomIndex::close()
+	{
+		this->file.close();
+		this->header = NULL;
+		this->entries = NULL;
+		this->strings = NULL;
+	}
+
+	// Entries are sorted by name, so this is a binary search
+	const RomIndexEntry* RomIndex::find(const char* name) const
+	{
+		const RomIndexEntry* first = this->entries;
+		const RomIndexEntry* last = this->entries + this->size();
+		const RomIndexEntry* it = std::lower_bound(first, last, name,
+			[this](const RomIndexEntry& e, const char* n) { return strcmp(this->name(e), n) < 0; });
+		return (it != last && strcmp(this->name(*it), name) == 0) ? it : NULL;
+	}
+
+	const RomIndexEntry* RomIndex::find(uint64_t rom_hash) const
+	{
+		for (size_t i = 0; i < this->size(); i++) {
+			if (this->entries[i].rom_hash == rom_hash) {
+				return &this->entries[i];
+			}
+		} // end for (i)
+		return NULL;
+	}
+
+	// threads = 0 starts one per hardware thread
+	RomIndexer::RomIndexer(uint32_t frames, uint32_t cycles_per_frame, unsigned int threads)
+		: frames(frames), cycles_per_frame(cycles_per_frame), thread_count(threads)
+	{
+		if (this->thread_count == 0) {
+			this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+		} // end if (thread_count == 0)
+	}
+
+	// Everything but the name and timestamp
+	void RomIndexer::index_rom(const uint8_t* data, size_t len, RomIndexEntry& e) const
+	{
+		e = RomIndexEntry();
+		e.rom_hash = hash64(data, len);
+		e.size = (uint32_t)len;
+		e.features = scan_rom(data, len);
+		e.variant = guess_variant(e.features);
+		e.quirks = guess_quirks(e.variant, e.features);
+		if (len > ROM_INDEX_CORE_MAX_SIZE) {
+			e.flags |= ROM_FLAG_TOO_LARGE;
+			return;
+		} // end if (too large)
+
+		Chip8 emu;
+		emu.set_quirks(e.quirks);
+		emu.load_game(data, len);
+
+		// the second half skips past blank and flashing start-up screens
+		size_t busiest = 0;
+		try {
+			for (uint32_t f = 0; f < this->frames; f++) {
+				emu.run_frame(this->cycles_per_frame);
+				e.flags |= emu.is_sound_on() ? ROM_FLAG_SOUND : 0;
+				if (f < this->frames / 2) {
+					continue;
+				} // end if (first half)
+
+				size_t lit = 0;
+				for (uint64_t row : *emu.get_graphics()) {
+					lit += std::bitset<64>(row).count();
+				} // end for (row)
+				if (lit >= busiest) {
+					busiest = lit;
+					e.thumbnail = *emu.get_graphics();
+				} // end if (lit >= busiest)
+			} // end for (f)
+		}
+		catch (const machine_fault&) {
+			e.flags |= ROM_FLAG_FAULTED;
+			if (busiest == 0) {
+				e.thumbnail = *emu.get_graphics();
+			} // end if (busiest == 0)
+		} // end try
+
+		e.flags |= emu.is_waiting_for_key() ? ROM_FLAG_WAITS_FOR_KEY : 0;
+	}
+
+	/**
+	 * Index every file in directory that could be a ROM and write the index
+	 * to index_path, replacing it in one step so readers never see half an
+	 * index. previous, if given, is closed once its entries are copied, so it
+	 * may be a mapping of index_path itself. Returns false if the directory
+	 * cannot be read or the index cannot be written.
+	 */
+	bool RomIndexer::build(const char* directory, const char* index_path, RomIndex* previous)
+	{
+		std::error_code error;
+		std::vector<fs::path> paths;
+		for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+			std::string ext = it->path().extension().string();
+			uintmax_t size = it->is_regular_file(error) ? it->file_size(error) : 0;
+			if (!error && size > 0 && size <= ROM_INDEX_MAX_SIZE && ext != ".md" && ext != ".txt" && ext != ".c8ix") {
+				paths.push_back(it->path());
+			} // end if (could be a ROM)
+		} // end for (it)
+		if (error) {
+			LOG_ERROR("Could not read directory '{}': {}", directory, error.message());
+			return false;
+		} // end if (error)
+
+		std::vector<std::string> names(paths.size());
+		for (size_t i = 0; i < paths.size(); i++) {
+			names[i] = paths[i].filename().string();
+		} // end for (i)
+		std::vector<size_t> order(paths.size());
+		for (size_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		} // end for (i)
+		std::sort(order.begin(), order.end(), [&names](size_t a, size_t b) { return names[a] < names[b]; });
+
+		// workers claim files in name order and fill in their own entries
+		std::vector<RomIndexEntry> entries(paths.size());
+		std::vector<uint8_t> valid(paths.size(), 0);
+		std::atomic<size_t> next(0);
+		std::atomic<size_t> indexed(0);
+		std::atomic<size_t> reused(0);
+		auto work = [&]() {
+			std::vector<uint8_t> data(ROM_INDEX_MAX_SIZE);
+			for (size_t k = next.fetch_add(1); k < order.size(); k = next.fetch_add(1)) {
+				size_t i = order[k];
+				std::error_code stat_error;
+				uint64_t modified = (uint64_t)fs::last_write_time(paths[i], stat_error).time_since_epoch().count();
+				uintmax_t size = fs::file_size(paths[i], stat_error);
+
+				const RomIndexEntry* old = (previous != NULL) ? previous->find(names[i].c_str()) : NULL;
+				if (!stat_error && old != NULL && old->size == size && old->modified == modified) {
+					entries[k] = *old;
+					valid[k] = 1;
+					reused++;
+					continue;
+				} // end if (unchanged)
+
+				FILE* file;
+				fopen_s(&file, paths[i].string().c_str(), "rb");
+				if (file == NULL) {
+					LOG_WARN("Could not open ROM '{}'.", paths[i].string());
+					continue;
+				} // end if (file == NULL)
+				size_t len = fread(data.data(), 1, data.size(), file);
+				fclose(file);
+
+				this->index_rom(data.data(), len, entries[k]);
+				entries[k].modified = modified;
+				valid[k] = 1;
+				indexed++;
+			} // end for (k)
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned int t = 1; t < std::min<size_t>(this->thread_count, paths.size()); t++) {
+			threads.emplace_back(work);
+		} // end for (t)
+		work();
+		for (std::thread& t : threads) {
+			t.join();
+		} // end for (t)
+		this->indexed = indexed.load();
+		this->reused = reused.load();
+		if (previous != NULL) {
+			previous->close();
+		} // end if (previous != NULL)
+
+		// drop unreadable files and lay out the string table
+		std::vector<RomIndexEntry> kept;
+		std::string strings;
+		for (size_t k = 0; k < order.size(); k++) {
+			if (valid[k]) {
+				entries[k].name_offset = (uint32_t)strings.size();
+				strings.append(names[order[k]]).push_back('\0');
+				kept.push_back(entries[k]);
+			} // end if (valid)
+		} // end for (k)
+
+		RomIndexHeader h = {};
+		memcpy(h.magic, ROM_INDEX_MAGIC, 4);
+		h.version = ROM_INDEX_VERSION;
+		h.entry_count = (uint32_t)kept.size();
+		h.entry_size = sizeof(RomIndexEntry);
+		h.frames = this->frames;
+		h.cycles_per_frame = this->cycles_per_frame;
+		h.strings_size = (uint32_t)strings.size();
+
+		std::string temp_path = std::string(index_path) + ".tmp";
+		FILE* out;
+		fopen_s(&out, temp_path.c_str(), "wb");
+		if (out == NULL) {
+			LOG_ERROR("Could not open file '{}'.", temp_path);
+			return false;
+		} // end if (out == NULL)
+		bool ok = fwrite(&h, sizeof(h), 1, out) == 1
+			&& fwrite(kept.data(), sizeof(RomIndexEntry), kept.size(), out) == kept.size()
+			&& fwrite(strings.data(), 1, strings.size(), out) == strings.size();
+		ok = (fclose(out) == 0) && ok;
+
+		if (ok) {
+			fs::rename(temp_path, index_path, error);
+			ok = !error;
+		} // end if (ok)
+		if (!ok) {
+			LOG_ERROR("Could not write ROM index '{}'.", index_path);
+			fs::remove(temp_path, error);
+		} // end if (!ok)
+		return ok;
+	}
+}
@@ -0,0 +1,145 @@
+/**
+ * RomIndex.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "Chip8.h"
+#include "MappedFile.h"
+
+/* Variant a ROM was written for, guessed from the instructions it can reach */
+#define ROM_VARIANT_CHIP8 0
+#define ROM_VARIANT_SCHIP 1
+#define ROM_VARIANT_XOCHIP 2
+
+/* Instructions found on the reachable code paths (RomIndexEntry::features) */
+#define ROM_FEATURE_SYS           0x0001    // 0nnn machine code call (COSMAC VIP)
+#define ROM_FEATURE_SHIFT_XY      0x0002    // 8xy6/8xyE with x != y, so QUIRK_SHIFT_VY changes the result
+#define ROM_FEATURE_JUMP_OFFSET   0x0004    // Bnnn
+#define ROM_FEATURE_LOAD_STORE    0x0008    // Fx55/Fx65
+#define ROM_FEATURE_HIRES         0x0010    // 00FE/00FF (SCHIP)
+#define ROM_FEATURE_SCROLL        0x0020    // 00Cn/00FB/00FC (SCHIP)
+#define ROM_FEATURE_EXIT          0x0040    // 00FD (SCHIP)
+#define ROM_FEATURE_BIG_SPRITE    0x0080    // Dxy0 (SCHIP)
+#define ROM_FEATURE_BIG_FONT      0x0100    // Fx30 (SCHIP)
+#define ROM_FEATURE_RPL_FLAGS     0x0200    // Fx75/Fx85 (SCHIP)
+#define ROM_FEATURE_SCROLL_UP     0x0400    // 00Dn (XO-CHIP)
+#define ROM_FEATURE_RANGE         0x0800    // 5xy2/5xy3 (XO-CHIP)
+#define ROM_FEATURE_LONG_I        0x1000    // F000 nnnn (XO-CHIP)
+#define ROM_FEATURE_PLANES        0x2000    // Fn01 (XO-CHIP)
+#define ROM_FEATURE_AUDIO         0x4000    // F002/Fx3A (XO-CHIP)
+#define ROM_FEATURE_INVALID       0x8000    // an opcode no variant defines
+
+#define ROM_FEATURES_SCHIP (ROM_FEATURE_HIRES | ROM_FEATURE_SCROLL | ROM_FEATURE_EXIT | ROM_FEATURE_BIG_SPRITE \
+	| ROM_FEATURE_BIG_FONT | ROM_FEATURE_RPL_FLAGS)
+#define ROM_FEATURES_XOCHIP (ROM_FEATURE_SCROLL_UP | ROM_FEATURE_RANGE | ROM_FEATURE_LONG_I | ROM_FEATURE_PLANES \
+	| ROM_FEATURE_AUDIO)
+
+/* What happened in the thumbnail run (RomIndexEntry::flags) */
+#define ROM_FLAG_FAULTED          0x01      // stopped on an unknown opcode or a stack error
+#define ROM_FLAG_WAITS_FOR_KEY    0x02      // halted on "LD Vx, K" at the end
+#define ROM_FLAG_SOUND            0x04      // turned the beeper on
+#define ROM_FLAG_TOO_LARGE        0x08      // does not fit this core's memory, so was not run
+
+#define ROM_INDEX_MAGIC "C8IX"
+#define ROM_INDEX_VERSION 1
+
+// XO-CHIP programs may fill a 64 KB address space; larger files are not ROMs
+#define ROM_INDEX_MAX_SIZE 0x10000
+
+// thumbnail run, about five seconds of play without input
+#define ROM_INDEX_DEFAULT_FRAMES 300
+#define ROM_INDEX_DEFAULT_CYCLES_PER_FRAME 10
+
+namespace c_plus_eight {
+	/* File header of a ROM index (host byte order) */
+	struct RomIndexHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t entry_count;       // RomIndexEntries following the header, sorted by name
+		uint32_t entry_size;
+		uint32_t frames;            // length of the thumbnail runs
+		uint32_t cycles_per_frame;
+		uint32_t strings_size;      // NUL-terminated file names following the entries
+		uint32_t reserved;
+	};
+
+	/* One ROM, with a framebuffer from its first seconds to show in a browser */
+	struct RomIndexEntry {
+		uint64_t rom_hash;          // hash64 of the whole file (Chip8::get_rom_hash() for ROMs that fit)
+		uint64_t modified;          // file system timestamp when indexed, only compared for equality
+		uint32_t size;
+		uint32_t name_offset;       // into the string table
+		uint16_t features;          // ROM_FEATURE_*
+		uint8_t variant;            // ROM_VARIANT_*
+		uint8_t quirks;             // QUIRK_* flags the ROM most likely needs
+		uint8_t flags;              // ROM_FLAG_*
+		uint8_t reserved[3];
+		Framebuffer thumbnail;      // busiest screen of the second half of the run
+	};
+
+	static_assert(sizeof(RomIndexHeader) == 32 && sizeof(RomIndexEntry) == 288, "ROM index layout changed");
+	static_assert(std::is_trivially_copyable<RomIndexEntry>::value, "RomIndexEntry must be trivially copyable");
+
+	uint16_t scan_rom(const uint8_t* data, size_t len);
+	uint8_t guess_variant(uint16_t features);
+	uint8_t guess_quirks(uint8_t variant, uint16_t features);
+
+	/**
+	 * ROM index mapped into memory and read in place: opening one costs a
+	 * mapping and a header check however many ROMs it lists, and thumbnails
+	 * are read straight out of the page cache.
+	 */
+	class RomIndex
+	{
+	private:
+		MappedFile file;
+		const RomIndexHeader* header = NULL;
+		const RomIndexEntry* entries = NULL;
+		const char* strings = NULL;
+
+	public:
+		bool open(const char* file_path);
+		void close();
+
+		size_t size() const { return (this->header != NULL) ? this->header->entry_count : 0; }
+		const RomIndexHeader& get_header() const { return *this->header; }
+		const RomIndexEntry& entry(size_t i) const { return this->entries[i]; }
+		const char* name(const RomIndexEntry& e) const { return this->strings + e.name_offset; }
+		const RomIndexEntry* find(const char* name) const;
+		const RomIndexEntry* find(uint64_t rom_hash) const;
+	};
+
+	/**
+	 * Builds a ROM index from a directory. Files are shared out to worker
+	 * threads, each of which hashes the file, scans its code for the variant
+	 * and quirks, and runs it headless for the thumbnail. Files whose size and
+	 * timestamp match an entry of the previous index are not read again.
+	 */
+	class RomIndexer
+	{
+	private:
+		uint32_t frames;
+		uint32_t cycles_per_frame;
+		unsigned int thread_count;
+
+		size_t indexed = 0;
+		size_t reused = 0;
+
+		void index_rom(const uint8_t* data, size_t len, RomIndexEntry& e) const;
+
+	public:
+		RomIndexer(uint32_t frames = ROM_INDEX_DEFAULT_FRAMES,
+			uint32_t cycles_per_frame = ROM_INDEX_DEFAULT_CYCLES_PER_FRAME, unsigned int threads = 0);
+
+		bool build(const char* directory, const char* index_path, RomIndex* previous = NULL);
+
+		size_t get_indexed() const { return this->indexed; }
+		size_t get_reused() const { return this->reused; }
+	};
+}
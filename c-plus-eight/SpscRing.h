@@ -0,0 +1,66 @@
+/**
+ * SpscRing.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace c_plus_eight {
+	/**
+	 * Fixed-capacity single-producer/single-consumer queue.
+	 * push() may only be called from one thread and pop()/peek() from one other
+	 * thread; neither side allocates or locks.
+	 */
+	template <typename T, size_t N>
+	class SpscRing
+	{
+		static_assert((N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+	private:
+		/* Next slot to read (owned by the consumer) */
+		alignas(64) std::atomic<size_t> head{ 0 };
+
+		/* Next slot to write (owned by the producer) */
+		alignas(64) std::atomic<size_t> tail{ 0 };
+
+		std::array<T, N> slots = {};
+
+	public:
+		// Enqueue an item, returns false if the ring is full
+		bool push(const T& item) {
+			size_t t = this->tail.load(std::memory_order_relaxed);
+			if (t - this->head.load(std::memory_order_acquire) == N) {
+				return false;
+			}
+
+			this->slots[t & (N - 1)] = item;
+			this->tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Look at the oldest item without removing it, returns false if empty
+		bool peek(T& item) const {
+			size_t h = this->head.load(std::memory_order_relaxed);
+			if (h == this->tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+
+			item = this->slots[h & (N - 1)];
+			return true;
+		}
+
+		// Dequeue the oldest item, returns false if empty
+		bool pop(T& item) {
+			if (!this->peek(item)) {
+				return false;
+			}
+
+			this->head.store(this->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			return true;
+		}
+	};
+}
@@ -0,0 +1,99 @@
+/**
+ * StealDeque.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace c_plus_eight {
+	/**
+	 * Fixed-capacity work-stealing deque (Chase-Lev). The owning thread pushes
+	 * and pops at the bottom, newest first; any other thread may steal from
+	 * the top, oldest first. Nothing locks or allocates after construction.
+	 */
+	template <typename T>
+	class StealDeque
+	{
+	private:
+		/* Next slot to steal from (shared by all thieves) */
+		alignas(64) std::atomic<int64_t> top{ 0 };
+
+		/* Next slot to push to (owned by the owner) */
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+
+		std::unique_ptr<std::atomic<T>[]> slots;
+		int64_t mask;
+
+	public:
+		// Capacity is rounded up to a power of two
+		StealDeque(size_t capacity) {
+			size_t n = 16;
+			while (n < capacity) {
+				n <<= 1;
+			}
+
+			this->slots = std::make_unique<std::atomic<T>[]>(n);
+			this->mask = (int64_t)n - 1;
+		}
+
+		// Owner only: add an item at the bottom, returns false if the deque is full
+		bool push(T item) {
+			int64_t b = this->bottom.load(std::memory_order_relaxed);
+			int64_t t = this->top.load(std::memory_order_acquire);
+			if (b - t > this->mask) {
+				return false;
+			}
+
+			this->slots[b & this->mask].store(item, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			this->bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Owner only: take the newest item, returns false if empty
+		bool pop(T& item) {
+			int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+			this->bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = this->top.load(std::memory_order_relaxed);
+
+			if (t > b) {
+				this->bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			item = this->slots[b & this->mask].load(std::memory_order_relaxed);
+			if (t == b) {
+				// last item, race the thieves for it
+				bool won = this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				this->bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+
+		// Any thread: take the oldest item, returns false if empty or another thread got it first
+		bool steal(T& item) {
+			int64_t t = this->top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = this->bottom.load(std::memory_order_acquire);
+			if (t >= b) {
+				return false;
+			}
+
+			item = this->slots[t & this->mask].load(std::memory_order_relaxed);
+			return this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		// Approximate, for statistics
+		size_t size() const {
+			int64_t n = this->bottom.load(std::memory_order_relaxed) - this->top.load(std::memory_order_relaxed);
+			return (n > 0) ? (size_t)n : 0;
+		}
+	};
+}
@@ -0,0 +1,112 @@
+/**
+ * Trace.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <string.h>
+#include "Trace.h"
+#include "Log.h"
+#include "Platform.h"
+
+namespace c_plus_eight {
+	bool TraceWriter::open(const char* file_path, const Chip8& emu, uint32_t cycles_per_frame)
+	{
+		this->close();
+
+		fopen_s(&this->out, file_path, "wb");
+		if (this->out == NULL) {
+			LOG_ERROR("Could not open file '{}'.", file_path);
+			return false;
+		} // end if
+
+		memset(&this->header, 0, sizeof(this->header));
+		memcpy(this->header.magic, TRACE_MAGIC, 4);
+		this->header.version = TRACE_VERSION;
+		this->header.rom_hash = emu.get_rom_hash();
+		this->header.seed = emu.get_seed();
+		this->header.cycles_per_frame = cycles_per_frame;
+		this->header.quirks = emu.get_quirks();
+		this->header.index_interval = TRACE_INDEX_INTERVAL;
+
+		// placeholder header, rewritten with the final counts on close
+		fwrite(&this->header, sizeof(this->header), 1, this->out);
+
+		this->buffer.resize(TRACE_BUFFER_RECORDS);
+		this->used = 0;
+		this->index.clear();
+		this->next_index_cycle = 0;
+		return true;
+	}
+
+	bool TraceWriter::close()
+	{
+		if (this->out == NULL) {
+			return false;
+		} // end if (out == NULL)
+
+		this->flush();
+		this->header.index_count = (uint32_t)this->index.size();
+		bool ok = fwrite(this->index.data(), sizeof(FrameIndexEntry), this->index.size(), this->out) == this->index.size()
+			&& fseek(this->out, 0, SEEK_SET) == 0
+			&& fwrite(&this->header, sizeof(this->header), 1, this->out) == 1;
+
+		ok = (fclose(this->out) == 0) && ok;
+		this->out = NULL;
+		return ok;
+	}
+
+	void TraceWriter::flush()
+	{
+		fwrite(this->buffer.data(), sizeof(TraceRecord), this->used, this->out);
+		this->header.record_count += this->used;
+		this->used = 0;
+	}
+
+	// Point every index slot the trace just crossed into at the record about to be pushed
+	void TraceWriter::add_index_entries(uint64_t cycle)
+	{
+		uint64_t cycles_per_slot = (uint64_t)TRACE_INDEX_INTERVAL * this->header.cycles_per_frame;
+		while (cycle > this->next_index_cycle) {
+			this->index.push_back({ (uint32_t)this->index.size() * TRACE_INDEX_INTERVAL, 0, this->header.record_count + this->used });
+			this->next_index_cycle += cycles_per_slot;
+		}
+	}
+
+	bool TraceReader::open(const char* file_path)
+	{
+		if (!this->file.open(file_path)) {
+			return false;
+		} // end if (!file.open)
+
+		const uint8_t* p = this->file.data();
+		size_t size = this->file.size();
+		const TraceHeader* h = reinterpret_cast<const TraceHeader*>(p);
+		if (size < sizeof(TraceHeader) || memcmp(h->magic, TRACE_MAGIC, 4) != 0 || h->version != TRACE_VERSION
+			|| h->cycles_per_frame == 0 || h->index_interval == 0) {
+			LOG_ERROR("'{}' is not a version {} trace.", file_path, TRACE_VERSION);
+			this->file.close();
+			return false;
+		} // end if (bad header)
+
+		// record_count is 64 bits, so rule out counts whose size would overflow first
+		uint64_t records_end = sizeof(TraceHeader) + h->record_count * sizeof(TraceRecord);
+		if (h->record_count > (size - sizeof(TraceHeader)) / sizeof(TraceRecord)
+			|| size < records_end + (uint64_t)h->index_count * sizeof(FrameIndexEntry)) {
+			LOG_ERROR("Trace '{}' is truncated.", file_path);
+			this->file.close();
+			return false;
+		} // end if (size too small)
+
+		this->header = h;
+		this->records = reinterpret_cast<const TraceRecord*>(p + sizeof(TraceHeader));
+		this->index = reinterpret_cast<const FrameIndexEntry*>(p + records_end);
+		return true;
+	}
+
+	// Index of the first instruction executed in frame (or later, if the machine was halted)
+	uint64_t TraceReader::seek(uint32_t frame) const
+	{
+		return seek_frame(this->index, this->header->index_count, this->header->index_interval,
+			this->header->record_count, frame, [this](uint64_t i) { return this->frame_of(this->records[i]); });
+	}
+}
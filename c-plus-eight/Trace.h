@@ -0,0 +1,114 @@
+/**
+ * Trace.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdio.h>
+#include <vector>
+
+#include "Chip8.h"
+#include "MappedFile.h"
+
+namespace c_plus_eight {
+	/* File header of an execution trace (host byte order) */
+	struct TraceHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t rom_hash;          // Chip8::get_rom_hash() of the traced ROM
+		uint64_t seed;              // RNG seed at power-on
+		uint32_t cycles_per_frame;  // run_frame() argument used for every frame
+		uint8_t quirks;             // QUIRK_* flags
+		uint8_t reserved[3];
+		uint64_t record_count;      // number of TraceRecords following the header
+		uint32_t index_count;       // number of FrameIndexEntries following the records
+		uint32_t index_interval;    // frames between index entries
+	};
+
+	/* One executed instruction, with the state it started from */
+	struct TraceRecord {
+		uint64_t cycle;     // Chip8::get_cycles() after the fetch
+		uint16_t pc;
+		uint16_t opcode;
+		uint16_t I;
+		uint8_t sp;
+		uint8_t vf;
+	};
+
+	static_assert(sizeof(TraceHeader) == 48 && sizeof(TraceRecord) == 16, "trace layout changed");
+
+#define TRACE_MAGIC "C8TR"
+#define TRACE_VERSION 1
+
+// frames between entries of the seek index written after the records
+#define TRACE_INDEX_INTERVAL 256
+
+// records buffered before each write
+#define TRACE_BUFFER_RECORDS 4096
+
+	/**
+	 * Streams the instructions executed by a machine to a trace file (attach
+	 * with Chip8::attach_trace). Tracing starts at power-on and assumes the
+	 * host runs every frame with the same cycle count, so the frame of a
+	 * record follows from its cycle.
+	 */
+	class TraceWriter
+	{
+	private:
+		FILE* out = NULL;
+		TraceHeader header;
+		std::vector<TraceRecord> buffer;
+		size_t used = 0;
+
+		/* Sparse frame index, written as a trailer on close */
+		std::vector<FrameIndexEntry> index;
+		uint64_t next_index_cycle = 0;
+
+		void flush();
+		void add_index_entries(uint64_t cycle);
+
+	public:
+		TraceWriter() {}
+		TraceWriter(const TraceWriter&) = delete;
+		TraceWriter& operator=(const TraceWriter&) = delete;
+		~TraceWriter() { this->close(); }
+
+		bool open(const char* file_path, const Chip8& emu, uint32_t cycles_per_frame);
+		bool close();
+
+		void push(const TraceRecord& rec) {
+			if (rec.cycle > this->next_index_cycle) {
+				this->add_index_entries(rec.cycle);
+			} // end if (index boundary)
+
+			this->buffer[this->used++] = rec;
+			if (this->used == this->buffer.size()) {
+				this->flush();
+			} // end if (buffer full)
+		}
+	};
+
+	/**
+	 * Trace file mapped into memory and read in place. seek() finds the first
+	 * instruction of a frame through the sparse index.
+	 */
+	class TraceReader
+	{
+	private:
+		MappedFile file;
+		const TraceHeader* header = NULL;
+		const TraceRecord* records = NULL;
+		const FrameIndexEntry* index = NULL;
+
+	public:
+		bool open(const char* file_path);
+
+		const TraceHeader& get_header() const { return *this->header; }
+		const TraceRecord* get_records() const { return this->records; }
+		uint64_t record_count() const { return this->header->record_count; }
+		uint32_t frame_of(const TraceRecord& rec) const { return (uint32_t)((rec.cycle - 1) / this->header->cycles_per_frame); }
+		uint64_t seek(uint32_t frame) const;
+	};
+}
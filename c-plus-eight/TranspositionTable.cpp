@@ -0,0 +1,88 @@
+/**
+ * TranspositionTable.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include "TranspositionTable.h"
+
+namespace c_plus_eight {
+	// Capacity is rounded up to a power of two; keep the table under ~70% full for short probes
+	TranspositionTable::TranspositionTable(size_t capacity)
+	{
+		size_t n = 16;
+		while (n < capacity) {
+			n <<= 1;
+		}
+
+		this->slots = std::make_unique<Slot[]>(n);
+		this->mask = n - 1;
+	}
+
+	/**
+	 * Record that a state was reached at the given depth. Returns true if it
+	 * is new, or was only seen deeper before (so it is worth expanding), and
+	 * false if it was already reached at this depth or shallower.
+	 */
+	bool TranspositionTable::visit(uint64_t key, uint32_t depth)
+	{
+		// 0 marks empty slots
+		if (key == 0) {
+			key = 1;
+		} // end if (key == 0)
+
+		for (size_t probe = 0, i = key & this->mask; probe <= this->mask; probe++, i = (i + 1) & this->mask) {
+			Slot& slot = this->slots[i];
+			uint64_t found = slot.key.load(std::memory_order_acquire);
+			if (found == 0) {
+				if (slot.key.compare_exchange_strong(found, key, std::memory_order_acq_rel)) {
+					this->count.fetch_add(1, std::memory_order_relaxed);
+					found = key;
+				}
+				// otherwise found now holds whoever claimed the slot first
+			} // end if (found == 0)
+
+			if (found != key) {
+				continue;
+			} // end if (found != key)
+
+			// lower the depth, the caller that lowers it gets to expand the state
+			uint32_t best = slot.depth.load(std::memory_order_relaxed);
+			while (depth < best) {
+				if (slot.depth.compare_exchange_weak(best, depth, std::memory_order_relaxed)) {
+					return true;
+				}
+			} // end while (depth < best)
+			return false;
+		} // end for (probe)
+
+		throw transposition_table_full_error();
+	}
+
+	bool TranspositionTable::contains(uint64_t key) const
+	{
+		if (key == 0) {
+			key = 1;
+		} // end if (key == 0)
+
+		for (size_t probe = 0, i = key & this->mask; probe <= this->mask; probe++, i = (i + 1) & this->mask) {
+			uint64_t found = this->slots[i].key.load(std::memory_order_acquire);
+			if (found == key) {
+				return true;
+			}
+			else if (found == 0) {
+				return false;
+			} // end if (found)
+		} // end for (probe)
+		return false;
+	}
+
+	// Not safe while other threads are visiting
+	void TranspositionTable::clear()
+	{
+		for (size_t i = 0; i <= this->mask; i++) {
+			this->slots[i].key.store(0, std::memory_order_relaxed);
+			this->slots[i].depth.store(UINT32_MAX, std::memory_order_relaxed);
+		} // end for (i)
+		this->count.store(0, std::memory_order_relaxed);
+	}
+}
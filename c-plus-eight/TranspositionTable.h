@@ -0,0 +1,50 @@
+/**
+ * TranspositionTable.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+
+namespace c_plus_eight {
+	struct transposition_table_full_error : public std::exception {
+		const char* what() const throw() {
+			return "Transposition table is full. Construct it with a larger capacity.";
+		}
+	};
+
+	/**
+	 * Fixed-size set of visited machine states (Chip8::state_hash) for state
+	 * space searches, shared by any number of searching threads without locks.
+	 * Open addressing with linear probing: a slot is claimed by a CAS on its
+	 * key, and each key remembers the smallest depth it was reached at. Entries
+	 * are never removed.
+	 */
+	class TranspositionTable
+	{
+	private:
+		struct Slot {
+			std::atomic<uint64_t> key{ 0 };         // 0 = empty
+			std::atomic<uint32_t> depth{ UINT32_MAX };
+		};
+
+		std::unique_ptr<Slot[]> slots;
+		size_t mask;
+		std::atomic<size_t> count{ 0 };
+
+	public:
+		TranspositionTable(size_t capacity);
+
+		bool visit(uint64_t key, uint32_t depth = 0);
+		bool contains(uint64_t key) const;
+		void clear();
+
+		size_t size() const { return this->count.load(std::memory_order_relaxed); }
+		size_t capacity() const { return this->mask + 1; }
+	};
+}
@@ -0,0 +1,91 @@
+// batch_bench.cpp : Benchmark for the lockstep batch engine against separate machines.
+//
+// Runs the same ROM on N lanes of a BatchEngine and on N separate Chip8s, feeding both the
+// same keys, then reports frames per second for each and checks that every lane ends up in
+// the same state as its machine. With "same" every lane gets the same keys and the lanes
+// stay together; with "mixed" each lane gets its own keys and they drift apart.
+//
+// usage: batch_bench <rom> [lanes] [frames] [same|mixed]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../Batch.h"
+#include "../Hash.h"
+
+#define CYCLES_PER_FRAME 10
+#define BENCH_RUNS 5
+
+// Keypad state that changes every few frames; one sequence for every lane unless mixed
+static uint16_t bench_keys(size_t lane, uint32_t frame, bool mixed)
+{
+    uint64_t h = c_plus_eight::hash64_key(mixed ? lane : 0, frame / 7);
+    return ((h & 3) == 0) ? (uint16_t)(1u << ((h >> 8) & 0xF)) : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cout << "usage: batch_bench <rom> [lanes] [frames] [same|mixed]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t lanes = (argc > 2) ? (size_t)atoi(argv[2]) : 256;
+    uint32_t frames = (argc > 3) ? (uint32_t)atoi(argv[3]) : 2000;
+    bool mixed = (argc > 4) && strcmp(argv[4], "mixed") == 0;
+
+    c_plus_eight::Chip8 boot;
+    if (!boot.load_game(argv[1])) {
+        return EXIT_FAILURE;
+    }
+
+    // best of a few runs, each from the boot state
+    double separate = 0;
+    double batched = 0;
+    size_t mismatches = 0;
+    std::unique_ptr<c_plus_eight::BatchEngine> batch;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        std::vector<std::unique_ptr<c_plus_eight::Chip8>> machines;
+        for (size_t i = 0; i < lanes; i++) {
+            machines.push_back(boot.clone());
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t f = 0; f < frames; f++) {
+            for (size_t i = 0; i < lanes; i++) {
+                machines[i]->set_keys(bench_keys(i, f, mixed));
+                machines[i]->run_frame(CYCLES_PER_FRAME);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        separate = (run == 0) ? seconds : std::min(separate, seconds);
+
+        batch = std::make_unique<c_plus_eight::BatchEngine>(boot, lanes);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t f = 0; f < frames; f++) {
+            for (size_t i = 0; i < lanes; i++) {
+                batch->set_keys(i, bench_keys(i, f, mixed));
+            }
+            batch->run_frame(CYCLES_PER_FRAME);
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        batched = (run == 0) ? seconds : std::min(batched, seconds);
+
+        for (size_t i = 0; i < lanes; i++) {
+            if (batch->lane(i).state_hash() != machines[i]->state_hash()) {
+                mismatches++;
+            }
+        } // end for (i)
+    } // end for (run)
+
+    double steps = (double)batch->get_vector_steps() + (double)batch->get_scalar_steps();
+    std::cout << lanes << " lanes x " << frames << " frames (" << (mixed ? "mixed" : "same") << " keys)" << std::endl;
+    std::cout << "separate machines: " << separate << "s, " << lanes * frames / separate << " frames/s" << std::endl;
+    std::cout << "batch engine:      " << batched << "s, " << lanes * frames / batched << " frames/s ("
+        << 100.0 * batch->get_vector_steps() / steps << "% of steps vectorized)" << std::endl;
+    std::cout << "speedup: " << separate / batched << "x, mismatches: " << mismatches << std::endl;
+    return (mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
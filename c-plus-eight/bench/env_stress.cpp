@@ -0,0 +1,140 @@
+// env_stress.cpp : Stress test and benchmark for the shared-memory environment protocol (Linux only).
+//
+// Forks a server running an Environment and a client driving it through EnvClient. The client
+// runs an identical Environment locally and checks every observation, reward and done flag it
+// receives, resetting at random points, then reports round-trip latency and throughput.
+//
+// usage: env_stress <rom> [instances] [steps]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include "../EnvClient.h"
+#include "../EnvServer.h"
+#include "../Hash.h"
+
+#define SHM_NAME "/c8env-stress"
+
+static c_plus_eight::EnvConfig make_config()
+{
+    c_plus_eight::EnvConfig config;
+    config.actions = { 0x0000, 0x0010, 0x0040, 0x0020 };
+    config.max_episode_frames = 2000;
+    return config;
+}
+
+static int run_client(const c_plus_eight::Chip8& boot, size_t steps)
+{
+    c_plus_eight::EnvClient client;
+    for (int tries = 0; !client.connect(SHM_NAME); tries++) {
+        if (tries == 100) {
+            return EXIT_FAILURE;
+        }
+        usleep(10000);
+    }
+
+    size_t count = client.size();
+    c_plus_eight::Environment local(boot, make_config(), count);
+    std::vector<uint32_t> actions(count);
+    std::vector<double> latency;
+    latency.reserve(steps);
+    size_t mismatches = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    c_plus_eight::EnvStepView view;
+    if (!client.reset(1, view)) {
+        return EXIT_FAILURE;
+    }
+    local.reset(1);
+    for (size_t s = 0; s < steps; s++) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (c_plus_eight::hash64_key(7, s) % 500 == 0) {
+            if (!client.reset(s, view)) {
+                return EXIT_FAILURE;
+            }
+            latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+            local.reset(s);
+        }
+        else {
+            uint32_t* shared = client.actions();
+            for (size_t i = 0; i < count; i++) {
+                shared[i] = actions[i] = (uint32_t)(c_plus_eight::hash64_key(s, i) % client.action_count());
+            }
+            if (!client.step(view)) {
+                return EXIT_FAILURE;
+            }
+            latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+            local.step(actions.data());
+        } // end if (reset)
+
+        for (size_t i = 0; i < count; i++) {
+            if (memcmp(&view.observations[i], &local.observation(i), sizeof(c_plus_eight::Framebuffer)) != 0
+                || view.rewards[i] != local.get_rewards()[i]
+                || view.terminals[i] != local.get_terminals()[i]
+                || view.truncations[i] != local.get_truncations()[i]) {
+                mismatches++;
+            }
+        } // end for (i)
+    } // end for (s)
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    client.shutdown();
+
+    std::sort(latency.begin(), latency.end());
+    // throughput includes the client's own checking run
+    spdlog::get("logger")->info("{} steps x {} instances in {:.3f}s: {:.0f} steps/s, {:.0f} env steps/s",
+        steps, count, seconds, steps / seconds, steps * count / seconds);
+    spdlog::get("logger")->info("round trip p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us",
+        latency[latency.size() / 2], latency[latency.size() * 99 / 100], latency.back());
+    spdlog::get("logger")->info("mismatches: {}", mismatches);
+    return (mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        auto logger = spdlog::stdout_color_mt("logger");
+    }
+    catch (spdlog::spdlog_ex& e) {
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    } // end try-catch
+
+    if (argc < 2) {
+        std::cout << "usage: env_stress <rom> [instances] [steps]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    size_t count = (argc > 2) ? (size_t)atoi(argv[2]) : 16;
+    size_t steps = (argc > 3) ? (size_t)atoi(argv[3]) : 20000;
+
+    c_plus_eight::Chip8 boot;
+    if (!boot.load_game(argv[1])) {
+        return EXIT_FAILURE;
+    }
+
+    c_plus_eight::Environment env(boot, make_config(), count);
+    c_plus_eight::EnvServer server(env);
+    if (!server.open(SHM_NAME)) {
+        return EXIT_FAILURE;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        _exit(run_client(boot, steps));
+    }
+
+    uint64_t served = server.serve();
+    int status = 0;
+    waitpid(child, &status, 0);
+    spdlog::get("logger")->info("server ran {} steps", served);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -3,11 +3,129 @@
 
 #include <iostream>
 #include <memory>
+#include <random>
 
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 
+#include "Audio.h"
 #include "Chip8.h"
+#include "Latency.h"
+#include "Movie.h"
+#include "Renderer.h"
+#include "Rewind.h"
+
+// instructions executed per 60 Hz frame
+#define CYCLES_PER_FRAME 10
+#define FRAMES_PER_SECOND 60
+
+// ROM loaded when none is given on the command line
+#define DEFAULT_ROM_PATH "c8games/INVADERS"
+
+// frames to run ahead of the real state before presenting (0 disables run-ahead)
+#define RUN_AHEAD_FRAMES 1
+
+// emulated frames per host frame while fast-forwarding (0 runs uncapped)
+#define FAST_FORWARD_MULTIPLIER 0
+
+// where the input movie is written with RECORD_MOVIE
+#define MOVIE_PATH "session.c8mv"
+
+// Translate a host key into a CHIP-8 key value (0xFF if unmapped)
+static uint8_t map_key(SDL_Keycode sym)
+{
+    switch (sym) {
+        /* row 1 */
+    case SDLK_1:
+        return 0x1;
+    case SDLK_2:
+        return 0x2;
+    case SDLK_3:
+        return 0x3;
+    case SDLK_4:
+        return 0xC;
+
+        /* row 2 */
+    case SDLK_q:
+        return 0x4;
+    case SDLK_w:
+        return 0x5;
+    case SDLK_e:
+        return 0x6;
+    case SDLK_r:
+        return 0xD;
+
+        /* row 3 */
+    case SDLK_a:
+        return 0x7;
+    case SDLK_s:
+        return 0x8;
+    case SDLK_d:
+        return 0x9;
+    case SDLK_f:
+        return 0xE;
+
+        /* row 4 */
+    case SDLK_z:
+        return 0xA;
+    case SDLK_x:
+        return 0x0;
+    case SDLK_c:
+        return 0xB;
+    case SDLK_v:
+        return 0xF;
+    default:
+        // invalid key, ignore event
+        return 0xFF;
+    } // end switch (sym)
+}
+
+/* Host-side controls that are not CHIP-8 keys */
+struct HostControls {
+    bool fast_forward = false;  // held Tab
+    bool rewind = false;        // held Backspace
+};
+
+// Apply a single SDL event to the emulator, returns false on quit
+static bool handle_event(c_plus_eight::Chip8& emu, const SDL_Event& e, c_plus_eight::LatencyTracker* latency, HostControls& controls)
+{
+#ifdef MEASURE_LATENCY
+    Uint64 received = SDL_GetPerformanceCounter();
+#endif
+
+    if (e.type == SDL_QUIT) {
+        return false;
+    }
+    else if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && e.key.keysym.sym == SDLK_TAB) {
+        // fast-forward while Tab is held
+        controls.fast_forward = (e.type == SDL_KEYDOWN);
+    }
+    else if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && e.key.keysym.sym == SDLK_BACKSPACE) {
+        // rewind while Backspace is held
+        controls.rewind = (e.type == SDL_KEYDOWN);
+    }
+    else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+        uint8_t key = map_key(e.key.keysym.sym);
+        if (key != 0xFF) {
+            if (e.type == SDL_KEYDOWN) {
+                emu.key_press(key);
+            }
+            else {
+                emu.key_release(key);
+            }
+
+#ifdef MEASURE_LATENCY
+            uint32_t id = emu.get_input_probe().applied;
+            latency->stamp(c_plus_eight::LatencyStage::Received, id, received);
+            latency->stamp(c_plus_eight::LatencyStage::Applied, id, SDL_GetPerformanceCounter());
+#else
+            (void)latency;
+#endif
+        } // end if (key != 0xFF)
+    } // end if (e.type)
+
+    return true;
+}
 
 int main(int argc, char* argv[])
 {
@@ -23,166 +141,184 @@ int main(int argc, char* argv[])
     spdlog::set_level(spdlog::level::debug);
 #endif
 
-    std::unique_ptr<c_plus_eight::Chip8> emu = std::make_unique<c_plus_eight::Chip8>();
-    if (!emu->load_game("c8games/INVADERS")) {
-        return EXIT_FAILURE;
-    } // end if (!emu->load_game)
-
     // main display loop
     try {
+        std::unique_ptr<c_plus_eight::Renderer> renderer = std::make_unique<c_plus_eight::Renderer>();
+        // seed the core once per session, RND is deterministic from here on
+        std::random_device rd;
+        uint64_t seed = ((uint64_t)rd() << 32) | rd();
+        spdlog::get("logger")->info("RNG seed: {}", seed);
+
+        std::unique_ptr<c_plus_eight::Chip8> emu = std::make_unique<c_plus_eight::Chip8>(seed);
+        const char* rom_path = (argc > 1) ? argv[1] : DEFAULT_ROM_PATH;
+        if (!emu->load_game(rom_path)) {
+            return EXIT_FAILURE;
+        } // end if (!emu->load_game)
+
+        // sound is optional, keep running silently without an audio device
+        std::unique_ptr<c_plus_eight::Audio> audio;
+        try {
+            audio = std::make_unique<c_plus_eight::Audio>(CYCLES_PER_FRAME * FRAMES_PER_SECOND);
+            emu->attach_sound(audio->get_events());
+        }
+        catch (c_plus_eight::audio_creation_failed_error& e) {
+            spdlog::get("logger")->warn(e.what());
+        } // end try-catch
+
+        // input-to-photon timestamps (only collected with MEASURE_LATENCY)
+        std::unique_ptr<c_plus_eight::LatencyTracker> latency = std::make_unique<c_plus_eight::LatencyTracker>(SDL_GetPerformanceFrequency());
+
+        // real machine state kept aside while running ahead, and its history for rewinding
+        std::unique_ptr<c_plus_eight::Chip8State> saved = std::make_unique<c_plus_eight::Chip8State>();
+        std::unique_ptr<c_plus_eight::RewindBuffer> rewind = std::make_unique<c_plus_eight::RewindBuffer>();
+
+#ifdef RECORD_MOVIE
+        std::unique_ptr<c_plus_eight::Movie> movie = std::make_unique<c_plus_eight::Movie>();
+        movie->begin(*emu, CYCLES_PER_FRAME);
+#endif
+
         bool active = true;
+        HostControls controls;
+        bool was_muted = false;
         SDL_Event e;
-        auto s_time = SDL_GetTicks();
+        Uint32 s_time = SDL_GetTicks();
+        Uint32 frame_count = 0;
         while (active) {
+            // wait for input until the next frame is due; while the core is halted
+            // on "LD Vx, K" with no timers running there is nothing to emulate,
+            // so block on the event queue instead
+            Uint32 due = s_time + (frame_count * 1000) / FRAMES_PER_SECOND;
+            Uint32 n_time = SDL_GetTicks();
+            int got_event;
+            if (emu->is_waiting_for_key() && !emu->timers_active()) {
+                got_event = SDL_WaitEvent(&e);
+            }
+            else {
+                got_event = SDL_WaitEventTimeout(&e, (due > n_time) ? (due - n_time) : 0);
+            } // end if (is_waiting_for_key)
+
             // handle SDL events
-            while (SDL_PollEvent(&e) != 0) {
-                if (e.type == SDL_QUIT) {
-                    active = false;
-                }
-                else if (e.type == SDL_KEYDOWN) {
-                    uint8_t key = 0xFF;
-                    switch (e.key.keysym.sym) {
-                        /* row 1 key pressed */
-                    case SDLK_1:
-                        key = 0x1;
-                        break;
-                    case SDLK_2:
-                        key = 0x2;
-                        break;
-                    case SDLK_3:
-                        key = 0x3;
-                        break;
-                    case SDLK_4:
-                        key = 0xC;
-                        break;
+            while (got_event != 0 && active) {
+                active = handle_event(*emu, e, latency.get(), controls);
+#ifdef RECORD_MOVIE
+                movie->record(*emu);
+#endif
+                got_event = SDL_PollEvent(&e);
+            } // end while (got_event != 0)
 
-                        /* row 2 key pressed */
-                    case SDLK_q:
-                        key = 0x4;
-                        break;
-                    case SDLK_w:
-                        key = 0x5;
-                        break;
-                    case SDLK_e:
-                        key = 0x6;
-                        break;
-                    case SDLK_r:
-                        key = 0xD;
-                        break;
+            n_time = SDL_GetTicks();
+            if (n_time < due) {
+                continue;
+            } // end if (n_time < due)
 
-                        /* row 3 key pressed */
-                    case SDLK_a:
-                        key = 0x7;
-                        break;
-                    case SDLK_s:
-                        key = 0x8;
-                        break;
-                    case SDLK_d:
-                        key = 0x9;
-                        break;
-                    case SDLK_f:
-                        key = 0xE;
-                        break;
+            // resynchronize after a long halt instead of replaying the missed frames
+            if ((n_time - due) > 250) {
+                s_time = n_time;
+                frame_count = 0;
+            } // end if (n_time - due > 250)
 
-                        /* row 4 key pressed */
-                    case SDLK_z:
-                        key = 0xA;
-                        break;
-                    case SDLK_x:
-                        key = 0x0;
-                        break;
-                    case SDLK_c:
-                        key = 0xB;
-                        break;
-                    case SDLK_v:
-                        key = 0xF;
-                        break;
-                    default:
-                        // invalid key pressed, ignore event
-                        break;
-                    } // end switch (e.key.keysym.sym)
-
-                    if (key != 0xFF) {
-                        emu->key_press(key);
-                    } // end if (key != 0xFF)
-                }
-                else if (e.type == SDL_KEYUP) {
-                    uint8_t key = 0xFF;
-                    switch (e.key.keysym.sym) {
-                        /* row 1 key released */
-                    case SDLK_1:
-                        key = 0x1;
-                        break;
-                    case SDLK_2:
-                        key = 0x2;
-                        break;
-                    case SDLK_3:
-                        key = 0x3;
-                        break;
-                    case SDLK_4:
-                        key = 0xC;
-                        break;
+            // mute the beeper while fast-forwarding or rewinding, then resync it with the sound timer
+            bool muted = controls.fast_forward || controls.rewind;
+            if (muted != was_muted && audio) {
+                audio->get_events()->push({ emu->get_cycles(), !muted && emu->is_sound_on() });
+                emu->attach_sound(muted ? NULL : audio->get_events());
+                was_muted = muted;
+            } // end if (muted != was_muted)
 
-                        /* row 2 key released */
-                    case SDLK_q:
-                        key = 0x4;
-                        break;
-                    case SDLK_w:
-                        key = 0x5;
-                        break;
-                    case SDLK_e:
-                        key = 0x6;
-                        break;
-                    case SDLK_r:
-                        key = 0xD;
-                        break;
+            // rewind: step back one recorded frame per host frame instead of emulating
+            if (controls.rewind) {
+                if (rewind->pop(*saved)) {
+                    emu->load_state(*saved);
+#ifdef RECORD_MOVIE
+                    movie->truncate(emu->get_frames());
+                    movie->record(*emu);
+#endif
+                } // end if (rewind->pop)
 
-                        /* row 3 key released */
-                    case SDLK_a:
-                        key = 0x7;
-                        break;
-                    case SDLK_s:
-                        key = 0x8;
-                        break;
-                    case SDLK_d:
-                        key = 0x9;
-                        break;
-                    case SDLK_f:
-                        key = 0xE;
-                        break;
+                if (emu->consume_screen_update()) {
+                    renderer->draw(emu->get_graphics());
+                } // end if (consume_screen_update)
+                ++frame_count;
+                continue;
+            } // end if (controls.rewind)
 
-                        /* row 4 key released */
-                    case SDLK_z:
-                        key = 0xA;
-                        break;
-                    case SDLK_x:
-                        key = 0x0;
-                        break;
-                    case SDLK_c:
-                        key = 0xB;
-                        break;
-                    case SDLK_v:
-                        key = 0xF;
-                        break;
-                    default:
-                        // invalid key released, ignore event
-                        break;
-                    } // end switch (e.key.keysym.sym)
+            // 60 Hz frame: run the CPU, tick the timers, present any changes
+            emu->run_frame(CYCLES_PER_FRAME);
+
+            // fast-forward: keep running emulated frames (timers tick once per emulated
+            // frame) for most of this host frame, then present only the latest one
+            if (controls.fast_forward) {
+                Uint64 deadline = SDL_GetPerformanceCounter() + (SDL_GetPerformanceFrequency() * 3) / (4 * FRAMES_PER_SECOND);
+                for (int frames = 1; ; frames++) {
+                    if (FAST_FORWARD_MULTIPLIER > 0) {
+                        if (frames >= FAST_FORWARD_MULTIPLIER) {
+                            break;
+                        }
+                    }
+                    else if ((frames % 64) == 0 && SDL_GetPerformanceCounter() >= deadline) {
+                        break;
+                    } // end if (FAST_FORWARD_MULTIPLIER > 0)
+
+                    emu->run_frame(CYCLES_PER_FRAME);
+                } // end for (frames)
+            } // end if (controls.fast_forward)
+
+#ifdef RECORD_MOVIE
+            movie->record(*emu);
+#endif
+
+            // snapshot the real frame for rewinding
+            emu->save_state(*saved);
+            rewind->push(*saved);
+
+            // run-ahead: speculatively run further frames with the current input and
+            // present the last one, then roll back so only the real frame counts
+            bool run_ahead = RUN_AHEAD_FRAMES > 0 && !controls.fast_forward;
+            bool screen_update = emu->consume_screen_update();
+            bool ahead_update = false;
+            if (run_ahead) {
+                emu->attach_sound(NULL);
+                for (int i = 0; i < RUN_AHEAD_FRAMES; i++) {
+                    emu->run_frame(CYCLES_PER_FRAME);
+                } // end for (i)
+                ahead_update = emu->consume_screen_update();
+            } // end if (run_ahead)
+
+#ifdef MEASURE_LATENCY
+            const c_plus_eight::InputProbe& probe = emu->get_input_probe();
+            latency->stamp(c_plus_eight::LatencyStage::Read, probe.read, SDL_GetPerformanceCounter());
+            latency->stamp(c_plus_eight::LatencyStage::Drawn, probe.drawn, SDL_GetPerformanceCounter());
+#endif
 
-                    if (key != 0xFF) {
-                        emu->key_release(key);
-                    } // end if (key != 0xFF)
-                } // end if (e.type == SDL_KEYUP)
-            } // end while (SDL_PollEvent != 0)
+            if (screen_update || ahead_update) {
+                renderer->draw(emu->get_graphics());
+#ifdef MEASURE_LATENCY
+                latency->stamp(c_plus_eight::LatencyStage::Presented, probe.drawn, SDL_GetPerformanceCounter());
+#endif
+            } // end if (screen_update)
 
-            emu->emulate_cycle();
+            if (run_ahead) {
+                emu->load_state(*saved);
+                emu->attach_sound(audio ? audio->get_events() : NULL);
 
-            // 60 Hz tick rate
-            auto n_time = SDL_GetTicks();
-            if ((n_time - s_time) >= 17) {
-                emu->tick();
-            } // end if (n_time - s_time >= REFRESH_RATE)
+                // load_state marks the screen for redrawing; that is only needed when the
+                // speculative frames drew something the real machine has not
+                if (!ahead_update) {
+                    emu->consume_screen_update();
+                } // end if (!ahead_update)
+            } // end if (run_ahead)
+            ++frame_count;
         } // end while (active)
+
+#ifdef MEASURE_LATENCY
+        latency->report();
+#endif
+
+#ifdef RECORD_MOVIE
+        if (movie->save(MOVIE_PATH)) {
+            spdlog::get("logger")->info("Movie saved to '{}' ({} frames).", MOVIE_PATH, movie->get_header().frame_count);
+        } // end if (movie->save)
+#endif
     }
     catch (std::exception& e) {
         std::cout << e.what() << std::endl;
@@ -190,4 +326,4 @@ int main(int argc, char* argv[])
     } // end try-catch
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
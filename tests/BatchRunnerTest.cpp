@@ -0,0 +1,73 @@
+/**
+ * BatchRunnerTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "BatchRunner.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+// Jobs give the same end state whichever worker runs them, and as a single machine
+TEST(BatchRunner, MatchesSingleMachine)
+{
+	BootCache cache;
+	std::vector<BatchJob> jobs;
+	for (const char* rom : TEST_ROMS) {
+		for (uint64_t seed = 0; seed < 4; seed++) {
+			BatchJob job;
+			job.rom_path = test_rom_path(rom);
+			job.boot.seed = seed;
+			job.frames = 300;
+			jobs.push_back(job);
+		}
+	}
+
+	BatchRunner runner(cache, 4, false);
+	runner.run(jobs);
+	ASSERT_EQ(runner.completed(), jobs.size());
+
+	for (size_t j = 0; j < jobs.size(); j++) {
+		Chip8 emu(jobs[j].boot.seed);
+		ASSERT_TRUE(emu.load_game(jobs[j].rom_path.c_str()));
+		for (uint32_t f = 0; f < jobs[j].frames; f++) {
+			emu.run_frame(jobs[j].boot.cycles_per_frame);
+		}
+		EXPECT_EQ(runner.result(j).status.load(), BATCH_DONE) << jobs[j].rom_path;
+		EXPECT_EQ(runner.result(j).state_hash, emu.state_hash()) << jobs[j].rom_path;
+	}
+}
+
+// A ROM that faults while booting fails its own job only
+TEST(BatchRunner, FaultWhileBootingFailsOnlyThatJob)
+{
+	std::string bad_rom = testing::TempDir() + "c8-bad-rom";
+	FILE* f = fopen(bad_rom.c_str(), "wb");
+	ASSERT_TRUE(f != NULL);
+	const uint8_t unknown[] = { 0xFF, 0xFF };
+	fwrite(unknown, 1, sizeof(unknown), f);
+	fclose(f);
+
+	BootCache cache;
+	std::vector<BatchJob> jobs(3);
+	jobs[0].rom_path = test_rom_path("PONG");
+	jobs[1].rom_path = bad_rom;
+	jobs[1].boot.frames = 1;
+	jobs[2].rom_path = test_rom_path("BRIX");
+
+	BatchRunner runner(cache, 2, false);
+	runner.run(jobs);
+	ASSERT_EQ(runner.completed(), jobs.size());
+	EXPECT_EQ(runner.result(0).status.load(), BATCH_DONE);
+	EXPECT_EQ(runner.result(1).status.load(), BATCH_FAULT);
+	EXPECT_NE(runner.result(1).fault[0], '\0');
+	EXPECT_EQ(runner.result(2).status.load(), BATCH_DONE);
+
+	remove(bad_rom.c_str());
+}
@@ -0,0 +1,95 @@
+/**
+ * BatchTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Batch.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+#define TEST_LANES 40
+#define TEST_FRAMES 600
+
+// Every structure-of-arrays lane matches a machine of its own fed the same keys
+TEST(BatchEngine, LanesMatchSeparateMachines)
+{
+	for (const char* rom : TEST_ROMS) {
+		Chip8 boot(3);
+		ASSERT_TRUE(boot.load_game(test_rom_path(rom).c_str())) << rom;
+
+		BatchEngine batch(boot, TEST_LANES);
+		std::vector<std::unique_ptr<Chip8>> machines;
+		for (size_t lane = 0; lane < TEST_LANES; lane++) {
+			machines.push_back(boot.clone());
+		}
+
+		for (uint32_t f = 0; f < TEST_FRAMES; f++) {
+			for (size_t lane = 0; lane < TEST_LANES; lane++) {
+				batch.set_keys(lane, test_keys(lane, f));
+				machines[lane]->set_keys(test_keys(lane, f));
+				machines[lane]->run_frame(10);
+			}
+			batch.run_frame(10);
+
+			if (f % 150 != 149) {
+				continue;
+			}
+			for (size_t lane = 0; lane < TEST_LANES; lane++) {
+				const Chip8& got = batch.lane(lane);
+				ASSERT_EQ(got.state_hash(), machines[lane]->state_hash()) << rom << " lane " << lane << " frame " << f;
+				ASSERT_EQ(got.frame_hash(), machines[lane]->frame_hash()) << rom << " lane " << lane << " frame " << f;
+				ASSERT_EQ(got.get_cycles(), machines[lane]->get_cycles()) << rom << " lane " << lane;
+			}
+		}
+		EXPECT_GT(batch.get_vector_steps(), 0u) << rom;
+	}
+}
+
+// With the same keys the lanes stay together, drawing, calling and reading keys in the vector path
+TEST(BatchEngine, SameKeysStayTogether)
+{
+	for (const char* rom : TEST_ROMS) {
+		Chip8 boot(3);
+		ASSERT_TRUE(boot.load_game(test_rom_path(rom).c_str())) << rom;
+
+		BatchEngine batch(boot, TEST_LANES);
+		std::unique_ptr<Chip8> machine = boot.clone();
+		for (uint32_t f = 0; f < TEST_FRAMES; f++) {
+			for (size_t lane = 0; lane < TEST_LANES; lane++) {
+				batch.set_keys(lane, test_keys(0, f));
+			}
+			machine->set_keys(test_keys(0, f));
+			machine->run_frame(10);
+			batch.run_frame(10);
+		}
+
+		for (size_t lane = 0; lane < TEST_LANES; lane++) {
+			ASSERT_EQ(batch.lane(lane).state_hash(), machine->state_hash()) << rom << " lane " << lane;
+			ASSERT_EQ(batch.lane(lane).frame_hash(), machine->frame_hash()) << rom << " lane " << lane;
+		}
+		EXPECT_GT(batch.get_vector_steps(), batch.get_scalar_steps()) << rom;
+	}
+}
+
+// A CALL run by the vector path still checks each lane's stack
+TEST(BatchEngine, StackOverflowThrows)
+{
+	// each CALL calls the next, 17 deep
+	std::vector<uint8_t> rom;
+	for (int i = 0; i < 17; i++) {
+		uint16_t next = 0x200 + (i + 1) * 2;
+		rom.push_back(0x20 | (next >> 8));
+		rom.push_back(next & 0xFF);
+	}
+	Chip8 boot;
+	ASSERT_TRUE(boot.load_game(rom.data(), rom.size()));
+
+	BatchEngine batch(boot, TEST_LANES);
+	EXPECT_THROW(batch.run_frame(20), stack_error);
+}
@@ -0,0 +1,83 @@
+/**
+ * BootCacheTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "BootCache.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+namespace fs = std::filesystem;
+
+static BootOptions boot_options(uint64_t seed)
+{
+	BootOptions options;
+	options.seed = seed;
+	options.frames = 120;
+	return options;
+}
+
+// Threads asking for the same ROMs at once all get the one prototype per ROM
+TEST(BootCache, ConcurrentCallersShareOnePrototype)
+{
+	BootCache cache;
+	std::vector<std::vector<const Chip8*>> seen(8);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < seen.size(); t++) {
+		threads.emplace_back([&, t]() {
+			for (const char* rom : TEST_ROMS) {
+				seen[t].push_back(cache.prototype(test_rom_path(rom).c_str(), boot_options(1)));
+			}
+		});
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+
+	EXPECT_EQ(cache.size(), sizeof(TEST_ROMS) / sizeof(TEST_ROMS[0]));
+	for (size_t t = 1; t < seen.size(); t++) {
+		EXPECT_EQ(seen[t], seen[0]);
+	}
+}
+
+// Snapshots written by one cache are picked up by the next, and no temporary files are left behind
+TEST(BootCache, SnapshotsSurviveAcrossCaches)
+{
+	fs::path dir = fs::path(testing::TempDir()) / "c8-boot-cache";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	std::vector<uint64_t> hashes;
+	{
+		BootCache cache(dir.string().c_str());
+		for (const char* rom : TEST_ROMS) {
+			const Chip8* proto = cache.prototype(test_rom_path(rom).c_str(), boot_options(2));
+			ASSERT_TRUE(proto != NULL) << rom;
+			hashes.push_back(proto->state_hash());
+		}
+	}
+
+	size_t files = 0;
+	for (const fs::directory_entry& e : fs::directory_iterator(dir)) {
+		EXPECT_EQ(e.path().extension(), ".c8ss") << e.path();
+		EXPECT_EQ(fs::file_size(e.path()), SAVE_STATE_SIZE) << e.path();
+		files++;
+	}
+	EXPECT_EQ(files, hashes.size());
+
+	BootCache cache(dir.string().c_str());
+	for (size_t r = 0; r < hashes.size(); r++) {
+		std::unique_ptr<Chip8> emu = cache.spawn(test_rom_path(TEST_ROMS[r]).c_str(), boot_options(2));
+		ASSERT_TRUE(emu != nullptr);
+		EXPECT_EQ(emu->state_hash(), hashes[r]) << TEST_ROMS[r];
+	}
+
+	fs::remove_all(dir);
+}
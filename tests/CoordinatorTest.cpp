@@ -0,0 +1,46 @@
+/**
+ * CoordinatorTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Coordinator.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+// Jobs run in worker processes end in the same state as run in this one
+TEST(Coordinator, MatchesInProcessRun)
+{
+	std::vector<BatchJob> jobs;
+	for (const char* rom : TEST_ROMS) {
+		for (uint64_t seed = 0; seed < 3; seed++) {
+			BatchJob job;
+			job.rom_path = test_rom_path(rom);
+			job.boot.seed = seed;
+			job.frames = 200;
+			jobs.push_back(job);
+		}
+	}
+	jobs.push_back(BatchJob());
+	jobs.back().rom_path = test_rom_path("NO SUCH ROM");
+
+	Coordinator coordinator(3);
+	ASSERT_TRUE(coordinator.run(jobs));
+
+	BootCache cache;
+	BatchRunner runner(cache, 1, false);
+	runner.run(jobs);
+	for (size_t j = 0; j < jobs.size(); j++) {
+		const ShardResult& r = coordinator.result(j);
+		EXPECT_EQ(r.status.load(), runner.result(j).status.load()) << j;
+		EXPECT_EQ(r.state_hash, runner.result(j).state_hash) << j;
+		EXPECT_EQ(r.frames, runner.result(j).frames) << j;
+		EXPECT_LT(r.worker, coordinator.get_process_count()) << j;
+	}
+	EXPECT_EQ(coordinator.result(jobs.size() - 1).status.load(), BATCH_FAULT);
+	EXPECT_EQ(coordinator.get_restarts(), 0u);
+}
@@ -0,0 +1,53 @@
+/**
+ * CoreApiTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+#include "CoreApi.h"
+
+// Offset of the stack pointer in a c8_save_state blob
+#define STATE_SP_OFFSET (sizeof(c_plus_eight::SaveStateHeader) + offsetof(c_plus_eight::Chip8State, regs) \
+	+ offsetof(c_plus_eight::Chip8Registers, sp))
+
+TEST(CoreApi, SaveStateRoundTripAndTamperedBlob)
+{
+	static const uint8_t rom[] = { 0x22, 0x04, 0x12, 0x00, 0x70, 0x01, 0x00, 0xEE };   // CALL 204; JP 200; ADD V0, 1; RET
+	c8_machine* m = c8_create(1);
+	ASSERT_NE(m, nullptr);
+	ASSERT_EQ(c8_load_rom(m, rom, sizeof(rom)), C8_OK);
+	ASSERT_EQ(c8_run_frames(m, 10, 7), C8_OK);
+
+	std::vector<uint8_t> blob(c8_state_size());
+	ASSERT_EQ(c8_save_state(m, blob.data(), blob.size()), C8_OK);
+
+	c8_machine* copy = c8_create(0);
+	ASSERT_EQ(c8_load_state(copy, blob.data(), blob.size()), C8_OK);
+	EXPECT_EQ(c8_state_hash(copy), c8_state_hash(m));
+
+	blob[STATE_SP_OFFSET] = 0xFF;
+	EXPECT_EQ(c8_load_state(copy, blob.data(), blob.size()), C8_ERR_BAD_STATE);
+
+	// the rejected blob left the last good state in place
+	ASSERT_EQ(c8_run_frames(copy, 10, 7), C8_OK);
+	ASSERT_EQ(c8_run_frames(m, 10, 7), C8_OK);
+	EXPECT_EQ(c8_state_hash(copy), c8_state_hash(m));
+
+	c8_destroy(copy);
+	c8_destroy(m);
+}
+
+TEST(CoreApi, StackFaultStatus)
+{
+	static const uint8_t rom[] = { 0x00, 0xEE };   // RET
+	c8_machine* m = c8_create(1);
+	ASSERT_NE(m, nullptr);
+	ASSERT_EQ(c8_load_rom(m, rom, sizeof(rom)), C8_OK);
+	EXPECT_EQ(c8_run_frames(m, 1, 10), C8_ERR_STACK);
+	EXPECT_EQ(c8_run_cycles(m, 10), C8_ERR_STACK);
+	c8_destroy(m);
+}
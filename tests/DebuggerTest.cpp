@@ -0,0 +1,140 @@
+/**
+ * DebuggerTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Debugger.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+#define TEST_FRAMES 150
+#define TEST_CYCLES_PER_FRAME 10
+
+/* The machine at the start of one forward step */
+struct Visit {
+	uint64_t cycle;
+	uint64_t hash;
+	bool waiting;
+	Framebuffer pixels;
+};
+
+// Play a ROM through the debugger one instruction at a time, noting every position passed
+static std::vector<Visit> record(Chip8& emu, Debugger& debugger)
+{
+	std::vector<Visit> visits;
+	uint16_t keys = 0;
+	for (uint32_t f = 0; f < TEST_FRAMES; f++) {
+		uint16_t want = test_keys(4, f);
+		for (uint8_t k = 0; k < 16; k++) {
+			if ((want & ~keys) & (1 << k)) {
+				debugger.key_press(k);
+			}
+			else if ((keys & ~want) & (1 << k)) {
+				debugger.key_release(k);
+			}
+		}
+		keys = want;
+
+		while (emu.get_frames() == f) {
+			visits.push_back({ emu.get_cycles(), emu.state_hash(), emu.is_waiting_for_key(), *emu.get_graphics() });
+			debugger.step();
+		}
+	}
+	return visits;
+}
+
+// Reverse steps land on the start of each earlier instruction, in the same state as when it first ran
+TEST(Debugger, ReverseStepMatchesForwardRun)
+{
+	for (const char* rom : { "BRIX", "TANK", "UFO" }) {
+		Chip8 emu(9);
+		ASSERT_TRUE(emu.load_game(test_rom_path(rom).c_str())) << rom;
+		Debugger debugger(emu, TEST_CYCLES_PER_FRAME);
+		std::vector<Visit> visits = record(emu, debugger);
+		uint64_t end_hash = emu.state_hash();
+		ASSERT_GT(debugger.keyframe_count(), 1u) << rom;
+
+		size_t steps = 0;
+		for (size_t v = visits.size(); v-- > 0; ) {
+			// reverse_step skips the cycles spent halted on "LD Vx, K"
+			if (visits[v].waiting) {
+				continue;
+			}
+			ASSERT_TRUE(debugger.reverse_step()) << rom << " visit " << v;
+			ASSERT_EQ(debugger.position(), visits[v].cycle) << rom;
+			ASSERT_EQ(emu.state_hash(), visits[v].hash) << rom << " cycle " << visits[v].cycle;
+			steps++;
+		}
+		EXPECT_FALSE(debugger.reverse_step()) << rom;
+		EXPECT_GT(steps, (size_t)TEST_FRAMES) << rom;
+
+		// and forward again to where it was
+		debugger.seek(visits.back().cycle);
+		debugger.step();
+		EXPECT_EQ(emu.state_hash(), end_hash) << rom;
+	}
+}
+
+// Each reverse continue to a pixel stops at the instruction that last changed it
+TEST(Debugger, ReverseContinuePixelMatchesForwardRun)
+{
+	Chip8 emu(9);
+	ASSERT_TRUE(emu.load_game(test_rom_path("BRIX").c_str()));
+	Debugger debugger(emu, TEST_CYCLES_PER_FRAME);
+	std::vector<Visit> visits = record(emu, debugger);
+	visits.push_back({ emu.get_cycles(), emu.state_hash(), emu.is_waiting_for_key(), *emu.get_graphics() });
+
+	// pixels along the ball's and paddle's paths, and a corner
+	const uint8_t pixels[][2] = { { 31, 30 }, { 30, 31 }, { 20, 33 }, { 15, 40 }, { 0, 0 } };
+	size_t total = 0;
+	for (const uint8_t* p : pixels) {
+		uint64_t mask = 1ULL << (63 - p[1]);
+		debugger.seek(visits.back().cycle);
+
+		for (size_t v = visits.size() - 1; v-- > 0; ) {
+			if (((visits[v].pixels[p[0]] ^ visits[v + 1].pixels[p[0]]) & mask) == 0) {
+				continue;
+			}
+			ASSERT_TRUE(debugger.reverse_continue_pixel(p[0], p[1])) << (int)p[0] << "," << (int)p[1];
+			ASSERT_EQ(debugger.position(), visits[v].cycle);
+			ASSERT_EQ(emu.state_hash(), visits[v].hash);
+			total++;
+		}
+		EXPECT_FALSE(debugger.reverse_continue_pixel(p[0], p[1]));
+	}
+	EXPECT_GT(total, 0u);
+}
+
+// A key pressed after going back replaces the recorded future from there on
+TEST(Debugger, NewInputInThePastTruncatesHistory)
+{
+	Chip8 emu(9);
+	ASSERT_TRUE(emu.load_game(test_rom_path("BRIX").c_str()));
+	Debugger debugger(emu, TEST_CYCLES_PER_FRAME);
+	std::vector<Visit> visits = record(emu, debugger);
+
+	const Visit& back = visits[visits.size() / 3];
+	debugger.seek(back.cycle);
+	ASSERT_EQ(emu.state_hash(), back.hash);
+	debugger.key_press(0x6);
+	EXPECT_EQ(debugger.end(), back.cycle);
+
+	// the new branch replays exactly from the keyframes before it
+	for (uint32_t f = 0; f < 30; f++) {
+		debugger.run_frame();
+	}
+	uint64_t branch_end = debugger.position();
+	uint64_t branch_hash = emu.state_hash();
+	EXPECT_NE(branch_hash, visits.back().hash);
+
+	debugger.seek(visits.front().cycle);
+	EXPECT_EQ(emu.state_hash(), visits.front().hash);
+	debugger.seek(branch_end);
+	EXPECT_EQ(emu.state_hash(), branch_hash);
+	EXPECT_EQ(debugger.end(), branch_end);
+}
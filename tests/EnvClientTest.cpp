@@ -0,0 +1,148 @@
+/**
+ * EnvClientTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "EnvClient.h"
+#include "EnvServer.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+static std::string shm_name(const char* test)
+{
+	return "/c8env-test-" + std::to_string(getpid()) + "-" + test;
+}
+
+// Serve an environment on BRIX from a child process
+static pid_t fork_server(const std::string& name)
+{
+	pid_t child = fork();
+	if (child == 0) {
+		Chip8 boot;
+		if (!boot.load_game(test_rom_path("BRIX").c_str())) {
+			_exit(1);
+		}
+		Environment env(boot, EnvConfig(), 4);
+		EnvServer server(env);
+		if (!server.open(name.c_str())) {
+			_exit(1);
+		}
+		server.serve();
+		_exit(0);
+	}
+	return child;
+}
+
+static bool connect_to(EnvClient& client, const std::string& name)
+{
+	for (int tries = 0; tries < 200; tries++) {
+		if (client.connect(name.c_str())) {
+			return true;
+		}
+		usleep(10000);
+	}
+	return false;
+}
+
+TEST(EnvClient, StepsAndShutsDown)
+{
+	std::string name = shm_name("steps");
+	pid_t server = fork_server(name);
+	EnvClient client;
+	ASSERT_TRUE(connect_to(client, name));
+
+	EnvStepView view;
+	ASSERT_TRUE(client.reset(3, view));
+	std::vector<uint32_t> actions(client.size(), 0);
+	for (uint64_t s = 1; s <= 10; s++) {
+		ASSERT_TRUE(client.step(actions.data(), view));
+		EXPECT_EQ(view.step, s);
+	}
+	EXPECT_TRUE(client.shutdown());
+
+	int status = 0;
+	ASSERT_EQ(waitpid(server, &status, 0), server);
+	EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+// A server that is killed makes the next command fail, even with no timeout set
+TEST(EnvClient, FailsWhenServerDies)
+{
+	std::string name = shm_name("dies");
+	pid_t server = fork_server(name);
+	EnvClient client;
+	ASSERT_TRUE(connect_to(client, name));
+	client.set_timeout(0);
+
+	EnvStepView view;
+	ASSERT_TRUE(client.step(view));
+	kill(server, SIGKILL);
+
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(client.step(view));
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+	EXPECT_FALSE(client.connected());
+
+	waitpid(server, NULL, 0);
+	shm_unlink(name.c_str());
+}
+
+// A server that is alive but stuck makes the command time out
+TEST(EnvClient, TimesOutWhenServerStalls)
+{
+	std::string name = shm_name("stalls");
+	pid_t server = fork_server(name);
+	EnvClient client;
+	ASSERT_TRUE(connect_to(client, name));
+	client.set_timeout(300);
+
+	EnvStepView view;
+	ASSERT_TRUE(client.step(view));
+	kill(server, SIGSTOP);
+	EXPECT_FALSE(client.step(view));
+
+	// the server may yet finish that step, but the client no longer reads the ring
+	EXPECT_FALSE(client.connected());
+	kill(server, SIGCONT);
+	EXPECT_FALSE(client.step(view));
+	EXPECT_EQ(client.size(), 0u);
+
+	kill(server, SIGKILL);
+	waitpid(server, NULL, 0);
+	shm_unlink(name.c_str());
+}
+
+// A client that exits without shutting the server down ends serve()
+TEST(EnvClient, ServerStopsWhenClientExits)
+{
+	std::string name = shm_name("client");
+	pid_t client_pid = fork();
+	if (client_pid == 0) {
+		EnvClient client;
+		EnvStepView view;
+		_exit((connect_to(client, name) && client.step(view)) ? 0 : 1);
+	}
+
+	Chip8 boot;
+	ASSERT_TRUE(boot.load_game(test_rom_path("BRIX").c_str()));
+	Environment env(boot, EnvConfig(), 2);
+	EnvServer server(env);
+	ASSERT_TRUE(server.open(name.c_str()));
+	EXPECT_EQ(server.serve(), 1u);
+
+	int status = 0;
+	ASSERT_EQ(waitpid(client_pid, &status, 0), client_pid);
+	EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
@@ -0,0 +1,87 @@
+/**
+ * EnvironmentTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <gtest/gtest.h>
+
+#include "Environment.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+// Faults on an unknown opcode for about half of the episode seeds, otherwise loops forever
+static const uint8_t COIN_FLIP_ROM[] = {
+	0xC0, 0x01,     // 200: RND V0, 1
+	0x30, 0x00,     // 202: SE V0, 0
+	0xFF, 0xFF,     // 204: unknown
+	0x12, 0x06,     // 206: JP 206
+};
+
+// One instance reaching an unknown opcode ends only its own episode
+TEST(Environment, FaultEndsOnlyThatInstancesEpisode)
+{
+	Chip8 boot;
+	ASSERT_TRUE(boot.load_game(COIN_FLIP_ROM, sizeof(COIN_FLIP_ROM)));
+	EnvConfig config;
+	config.auto_reset = false;
+	Environment env(boot, config, 16);
+
+	std::vector<uint32_t> actions(env.size(), 0);
+	env.step(actions.data());
+
+	uint64_t terminal = 0;
+	for (size_t i = 0; i < env.size(); i++) {
+		terminal += env.get_terminals()[i];
+		EXPECT_EQ(env.get_terminals()[i] != 0, env.instance(i).get_pc() == 0x204) << i;
+	}
+	EXPECT_GT(terminal, 0u);
+	EXPECT_LT(terminal, env.size());
+	EXPECT_EQ(env.get_stats().faults, terminal);
+	EXPECT_EQ(env.get_stats().episodes, terminal);
+
+	// the looping instances keep stepping; the finished ones wait for reset() without counting again
+	std::vector<uint64_t> cycles(env.size());
+	for (size_t i = 0; i < env.size(); i++) {
+		cycles[i] = env.instance(i).get_cycles();
+	}
+	env.step(actions.data());
+	EXPECT_EQ(env.get_stats().faults, terminal);
+	EXPECT_EQ(env.get_stats().episodes, terminal);
+	for (size_t i = 0; i < env.size(); i++) {
+		bool done = env.instance(i).get_pc() == 0x204;
+		EXPECT_EQ(env.get_terminals()[i] != 0, done) << i;
+		EXPECT_EQ(env.instance(i).get_cycles() == cycles[i], done) << i;
+	}
+
+	// reset() starts every instance over
+	env.reset(0);
+	env.step(actions.data());
+	EXPECT_EQ(env.get_stats().faults, terminal);
+}
+
+// Same seed, same actions: same rewards and observations
+TEST(Environment, ResetSeedIsReproducible)
+{
+	Chip8 boot;
+	ASSERT_TRUE(boot.load_game(test_rom_path("BRIX").c_str()));
+	EnvConfig config;
+	config.actions = { 0x0000, 1 << 0x4, 1 << 0x6 };
+	Environment a(boot, config, 4);
+	Environment b(boot, config, 4);
+	a.reset(42);
+	b.reset(42);
+
+	std::vector<uint32_t> actions(4);
+	for (uint32_t s = 0; s < 200; s++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			actions[i] = (uint32_t)(test_keys(i, s) % 3);
+		}
+		a.step(actions.data());
+		b.step(actions.data());
+		for (size_t i = 0; i < 4; i++) {
+			ASSERT_EQ(a.instance(i).state_hash(), b.instance(i).state_hash()) << s;
+		}
+	}
+	EXPECT_EQ(a.get_stats().faults, 0u);
+}
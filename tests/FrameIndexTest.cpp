@@ -0,0 +1,158 @@
+/**
+ * FrameIndexTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Movie.h"
+#include "Trace.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+#define TEST_FRAMES 3000
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+	std::vector<uint8_t> bytes;
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f != NULL) {
+		uint8_t buf[4096];
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+			bytes.insert(bytes.end(), buf, buf + n);
+		}
+		fclose(f);
+	}
+	return bytes;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+	FILE* f = fopen(path.c_str(), "wb");
+	ASSERT_TRUE(f != NULL);
+	fwrite(bytes.data(), 1, bytes.size(), f);
+	fclose(f);
+}
+
+// Point every index entry of a file past the end of its records
+static void corrupt_index(const std::string& path, uint32_t index_count)
+{
+	std::vector<uint8_t> bytes = read_file(path);
+	size_t start = bytes.size() - (size_t)index_count * sizeof(FrameIndexEntry);
+	for (uint32_t e = 0; e < index_count; e++) {
+		uint64_t record = 0xFFFFFFFFFFFFULL + e;
+		memcpy(&bytes[start + e * sizeof(FrameIndexEntry) + offsetof(FrameIndexEntry, record)], &record, sizeof(record));
+	}
+	write_file(path, bytes);
+}
+
+static std::string record_movie(const char* name)
+{
+	Chip8 emu(4);
+	EXPECT_TRUE(emu.load_game(test_rom_path("TETRIS").c_str()));
+	Movie movie;
+	movie.begin(emu, 10);
+	for (uint32_t f = 0; f < TEST_FRAMES; f++) {
+		emu.set_keys(test_keys(8, f));
+		movie.record(emu);
+		emu.run_frame(10);
+	}
+	std::string path = testing::TempDir() + name;
+	EXPECT_TRUE(movie.save(path.c_str()));
+	return path;
+}
+
+TEST(FrameIndex, MovieSeekFindsFirstRecordOfFrame)
+{
+	std::string path = record_movie("c8-seek.c8mv");
+	MovieReader reader;
+	ASSERT_TRUE(reader.open(path.c_str()));
+	ASSERT_GT(reader.get_header().index_count, 1u);
+
+	const MovieRecord* recs = reader.get_records();
+	for (uint32_t frame = 0; frame <= TEST_FRAMES + 10; frame += 7) {
+		size_t expected = std::lower_bound(recs, recs + reader.record_count(), frame,
+			[](const MovieRecord& r, uint32_t f) { return r.frame < f; }) - recs;
+		EXPECT_EQ(reader.seek(frame), expected) << frame;
+	}
+	remove(path.c_str());
+}
+
+// An index pointing past the records never sends seek past the end
+TEST(FrameIndex, CorruptMovieIndexStaysInBounds)
+{
+	std::string path = record_movie("c8-corrupt.c8mv");
+	uint32_t index_count;
+	{
+		MovieReader reader;
+		ASSERT_TRUE(reader.open(path.c_str()));
+		index_count = reader.get_header().index_count;
+	}
+	corrupt_index(path, index_count);
+
+	MovieReader reader;
+	ASSERT_TRUE(reader.open(path.c_str()));
+	for (uint32_t frame = 0; frame <= TEST_FRAMES; frame += 100) {
+		EXPECT_LE(reader.seek(frame), reader.record_count()) << frame;
+	}
+	remove(path.c_str());
+}
+
+TEST(FrameIndex, TraceSeekAndCorruptTraces)
+{
+	std::string path = testing::TempDir() + "c8-seek.c8tr";
+	{
+		Chip8 emu(4);
+		ASSERT_TRUE(emu.load_game(test_rom_path("PONG").c_str()));
+		TraceWriter writer;
+		ASSERT_TRUE(writer.open(path.c_str(), emu, 10));
+		emu.attach_trace(&writer);
+		for (uint32_t f = 0; f < 1000; f++) {
+			emu.run_frame(10);
+		}
+		emu.attach_trace(NULL);
+		ASSERT_TRUE(writer.close());
+	}
+
+	uint32_t index_count;
+	{
+		TraceReader reader;
+		ASSERT_TRUE(reader.open(path.c_str()));
+		index_count = reader.get_header().index_count;
+		ASSERT_GT(index_count, 1u);
+		for (uint32_t frame = 0; frame < 1000; frame += 13) {
+			uint64_t i = reader.seek(frame);
+			ASSERT_LT(i, reader.record_count());
+			EXPECT_EQ(reader.frame_of(reader.get_records()[i]), frame);
+			EXPECT_TRUE(i == 0 || reader.frame_of(reader.get_records()[i - 1]) < frame);
+		}
+	}
+
+	std::vector<uint8_t> good = read_file(path);
+	corrupt_index(path, index_count);
+	{
+		TraceReader reader;
+		ASSERT_TRUE(reader.open(path.c_str()));
+		for (uint32_t frame = 0; frame < 1000; frame += 50) {
+			EXPECT_LE(reader.seek(frame), reader.record_count()) << frame;
+		}
+	}
+
+	// a record count whose size wraps around 64 bits must not pass the size check
+	std::vector<uint8_t> bad = good;
+	uint64_t huge = (1ULL << 60) + 1;
+	memcpy(&bad[offsetof(TraceHeader, record_count)], &huge, sizeof(huge));
+	write_file(path, bad);
+	TraceReader reader;
+	EXPECT_FALSE(reader.open(path.c_str()));
+
+	remove(path.c_str());
+}
@@ -0,0 +1,60 @@
+/**
+ * KeyWaitTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+
+using namespace c_plus_eight;
+
+// Starts the delay timer, waits for a key, then reads the timer back
+static const uint8_t KEY_WAIT_ROM[] = {
+	0x6A, 0x3C,     // 200: LD VA, 60
+	0xFA, 0x15,     // 202: LD DT, VA
+	0xFB, 0x0A,     // 204: LD VB, K
+	0xFC, 0x07,     // 206: LD VC, DT
+	0x12, 0x08,     // 208: JP 208
+};
+
+// "LD Vx, K" halts the machine until a key is pressed, while emulated time keeps passing
+TEST(KeyWait, HaltsUntilKeyPress)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(KEY_WAIT_ROM, sizeof(KEY_WAIT_ROM)));
+
+	for (int frame = 0; frame < 10; frame++) {
+		emu.run_frame(10);
+		ASSERT_TRUE(emu.is_waiting_for_key());
+		EXPECT_EQ(emu.get_pc(), 0x204);
+		EXPECT_EQ(emu.get_register(0xB), 0);
+		EXPECT_EQ(emu.get_cycles(), (uint64_t)(frame + 1) * 10);
+	} // end for (frame)
+	EXPECT_TRUE(emu.timers_active());
+
+	emu.key_press(0x7);
+	EXPECT_FALSE(emu.is_waiting_for_key());
+	EXPECT_EQ(emu.get_register(0xB), 0x7);
+	EXPECT_EQ(emu.get_pc(), 0x206);
+
+	// the delay timer ran down by one per frame spent halted
+	emu.run_frame(10);
+	EXPECT_EQ(emu.get_register(0xC), 50);
+	EXPECT_EQ(emu.get_pc(), 0x208);
+	EXPECT_EQ(emu.get_cycles(), 110u);
+}
+
+// A key already held when "LD Vx, K" runs is taken without halting
+TEST(KeyWait, TakesHeldKey)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(KEY_WAIT_ROM, sizeof(KEY_WAIT_ROM)));
+	emu.key_press(0x3);
+	emu.run_frame(10);
+
+	EXPECT_FALSE(emu.is_waiting_for_key());
+	EXPECT_EQ(emu.get_register(0xB), 0x3);
+	EXPECT_EQ(emu.get_register(0xC), 60);
+	EXPECT_EQ(emu.get_pc(), 0x208);
+}
@@ -0,0 +1,154 @@
+/**
+ * LockstepTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+#include "Lockstep.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+#define TEST_CYCLES_PER_FRAME 10
+
+// Waits out the delay timer in the usual loop, over and over with a different wait each time
+static const uint8_t DELAY_LOOP_ROM[] = {
+	0x7A, 0x07,     // 200: ADD VA, 7
+	0xFA, 0x15,     // 202: LD DT, VA
+	0xF0, 0x07,     // 204: LD V0, DT
+	0x30, 0x00,     // 206: SE V0, 0
+	0x12, 0x04,     // 208: JP 204
+	0x7B, 0x01,     // 20A: ADD VB, 1
+	0x12, 0x00,     // 20C: JP 200
+};
+
+// Starts both timers, then waits for a key; each key draws a digit and waits again
+static const uint8_t KEY_WAIT_ROM[] = {
+	0x6A, 0x3C,     // 200: LD VA, 60
+	0xFA, 0x15,     // 202: LD DT, VA
+	0xFA, 0x18,     // 204: LD ST, VA
+	0xFB, 0x0A,     // 206: LD VB, K
+	0xFB, 0x29,     // 208: LD F, VB
+	0xD0, 0x15,     // 20A: DRW V0, V1, 5
+	0x70, 0x05,     // 20C: ADD V0, 5
+	0x12, 0x06,     // 20E: JP 206
+};
+
+static void expect_same_machine(const Chip8& a, const Chip8& b)
+{
+	EXPECT_EQ(a.state_hash(), b.state_hash());
+	EXPECT_EQ(a.frame_hash(), b.frame_hash());
+	EXPECT_EQ(a.get_frames(), b.get_frames());
+	EXPECT_EQ(a.get_cycles(), b.get_cycles());
+	EXPECT_EQ(a.get_pc(), b.get_pc());
+}
+
+// skip_frames(n) from every point of a ROM matches n calls to run_frame()
+static void check_skip_frames(const uint8_t* rom, size_t len, uint16_t keys_at_start)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(rom, len));
+	emu.set_keys(keys_at_start);
+
+	const uint32_t counts[] = { 1, 2, 6, 7, 8, 30, 100, 300 };
+	for (uint32_t start = 0; start < 120; start++) {
+		for (uint32_t n : counts) {
+			Chip8 skipped(emu);
+			Chip8 run(emu);
+			skipped.skip_frames(n, TEST_CYCLES_PER_FRAME);
+			for (uint32_t f = 0; f < n; f++) {
+				run.run_frame(TEST_CYCLES_PER_FRAME);
+			}
+			SCOPED_TRACE(testing::Message() << "start " << start << ", skip " << n);
+			expect_same_machine(skipped, run);
+		} // end for (n)
+
+		emu.run_frame(TEST_CYCLES_PER_FRAME);
+		// tap a key now and then so the key-wait ROM moves on
+		emu.set_keys((start % 25 == 24) ? 0x0010 : 0);
+	} // end for (start)
+}
+
+TEST(SkipFrames, MatchesRunFrameInDelayLoop)
+{
+	check_skip_frames(DELAY_LOOP_ROM, sizeof(DELAY_LOOP_ROM), 0);
+}
+
+TEST(SkipFrames, MatchesRunFrameWhileWaitingForKey)
+{
+	check_skip_frames(KEY_WAIT_ROM, sizeof(KEY_WAIT_ROM), 0);
+}
+
+// Every instance read back after sync() is the machine a plain run_frame() loop gives
+static void check_scheduler(const Chip8& boot, size_t count, uint32_t frames)
+{
+	LockstepScheduler scheduler(boot, count, TEST_CYCLES_PER_FRAME);
+	std::vector<Chip8> plain(count, boot);
+	uint32_t slept = 0;
+
+	for (uint32_t f = 0; f < frames; f++) {
+		for (uint32_t i = 0; i < count; i++) {
+			// instance 0 never gets input, so it stays in any key wait
+			uint16_t keys = (i == 0) ? 0 : test_keys(i, f);
+			scheduler.set_keys(i, keys);
+			plain[i].set_keys(keys);
+			plain[i].run_frame(TEST_CYCLES_PER_FRAME);
+		} // end for (i)
+		scheduler.run_frame();
+		slept += scheduler.get_sleeping();
+
+		if (f % 50 == 49) {
+			scheduler.sync();
+			for (uint32_t i = 0; i < count; i++) {
+				SCOPED_TRACE(testing::Message() << "frame " << f << ", instance " << i);
+				expect_same_machine(scheduler.instance(i), plain[i]);
+			} // end for (i)
+		} // end if (f % 50 == 49)
+	} // end for (f)
+	EXPECT_EQ(scheduler.get_faulted(), 0u);
+	EXPECT_GT(slept, 0u) << "no instance ever slept, so nothing was skipped";
+}
+
+TEST(LockstepScheduler, MatchesPlainRunInDelayLoop)
+{
+	Chip8 boot;
+	ASSERT_TRUE(boot.load_game(DELAY_LOOP_ROM, sizeof(DELAY_LOOP_ROM)));
+	check_scheduler(boot, 4, 400);
+}
+
+TEST(LockstepScheduler, MatchesPlainRunWhileWaitingForKey)
+{
+	Chip8 boot;
+	ASSERT_TRUE(boot.load_game(KEY_WAIT_ROM, sizeof(KEY_WAIT_ROM)));
+	check_scheduler(boot, 4, 400);
+}
+
+TEST(LockstepScheduler, MatchesPlainRunOnTestRoms)
+{
+	for (const char* name : TEST_ROMS) {
+		SCOPED_TRACE(name);
+		Chip8 boot;
+		ASSERT_TRUE(boot.load_game(test_rom_path(name).c_str()));
+		LockstepScheduler scheduler(boot, 3, TEST_CYCLES_PER_FRAME);
+		std::vector<Chip8> plain(3, boot);
+
+		for (uint32_t f = 0; f < 600; f++) {
+			for (uint32_t i = 0; i < 3; i++) {
+				uint16_t keys = test_keys(i, f);
+				scheduler.set_keys(i, keys);
+				plain[i].set_keys(keys);
+				plain[i].run_frame(TEST_CYCLES_PER_FRAME);
+			} // end for (i)
+			scheduler.run_frame();
+		} // end for (f)
+
+		scheduler.sync();
+		for (uint32_t i = 0; i < 3; i++) {
+			expect_same_machine(scheduler.instance(i), plain[i]);
+		} // end for (i)
+	} // end for (name)
+}
@@ -0,0 +1,98 @@
+/**
+ * MovieTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Movie.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+// Playing back a recorded session, from memory, a loaded file or a mapped one, shows the same frames
+TEST(Movie, PlaybackReproducesRecordedFrames)
+{
+	for (const char* rom : TEST_ROMS) {
+		Chip8 emu(11);
+		ASSERT_TRUE(emu.load_game(test_rom_path(rom).c_str())) << rom;
+		emu.set_quirks(QUIRK_SHIFT_VY);
+		Movie movie;
+		movie.begin(emu, 12);
+
+		// keys change mid-frame too, so some frames carry several records
+		std::vector<uint64_t> recorded;
+		for (uint32_t f = 0; f < 900; f++) {
+			emu.set_keys(test_keys(5, f));
+			movie.record(emu);
+			if (f % 11 == 0) {
+				emu.key_press(0x5);
+				movie.record(emu);
+				emu.key_release(0x5);
+				movie.record(emu);
+			}
+			emu.run_frame(12);
+			recorded.push_back(emu.frame_hash());
+		}
+		movie.record(emu);
+		ASSERT_EQ(movie.get_header().frame_count, 900u) << rom;
+
+		std::string path = testing::TempDir() + "c8-play.c8mv";
+		ASSERT_TRUE(movie.save(path.c_str()));
+		Movie loaded;
+		ASSERT_TRUE(loaded.load(path.c_str())) << rom;
+		MovieReader mapped;
+		ASSERT_TRUE(mapped.open(path.c_str())) << rom;
+
+		// a fresh machine with another seed and quirks: the movie brings its own
+		Chip8 a(99), b(99), c(99);
+		for (Chip8* m : { &a, &b, &c }) {
+			ASSERT_TRUE(m->load_game(test_rom_path(rom).c_str()));
+		}
+		std::vector<uint64_t> from_memory, from_file, from_mapping;
+		ASSERT_TRUE(play_movie(a, movie, &from_memory)) << rom;
+		ASSERT_TRUE(play_movie(b, loaded, &from_file)) << rom;
+		ASSERT_TRUE(play_movie(c, mapped, &from_mapping)) << rom;
+		EXPECT_EQ(from_memory, recorded) << rom;
+		EXPECT_EQ(from_file, recorded) << rom;
+		EXPECT_EQ(from_mapping, recorded) << rom;
+		EXPECT_EQ(a.state_hash(), emu.state_hash()) << rom;
+		remove(path.c_str());
+	}
+}
+
+// A header claiming more records than the file holds is rejected before anything is allocated
+TEST(Movie, LoadRejectsRecordCountBeyondFile)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(test_rom_path("PONG").c_str()));
+	Movie movie;
+	movie.begin(emu, 10);
+	for (uint32_t f = 0; f < 200; f++) {
+		emu.set_keys(test_keys(3, f));
+		movie.record(emu);
+		emu.run_frame(10);
+	}
+	std::string path = testing::TempDir() + "c8-count.c8mv";
+	ASSERT_TRUE(movie.save(path.c_str()));
+
+	Movie loaded;
+	ASSERT_TRUE(loaded.load(path.c_str()));
+	EXPECT_EQ(loaded.get_records().size(), movie.get_records().size());
+
+	const uint32_t counts[] = { 0xFFFFFFFFu, (uint32_t)movie.get_records().size() + 1000 };
+	for (uint32_t count : counts) {
+		FILE* f = fopen(path.c_str(), "r+b");
+		ASSERT_TRUE(f != NULL);
+		fseek(f, offsetof(MovieHeader, record_count), SEEK_SET);
+		fwrite(&count, sizeof(count), 1, f);
+		fclose(f);
+		EXPECT_FALSE(loaded.load(path.c_str())) << count;
+	}
+	remove(path.c_str());
+}
@@ -0,0 +1,77 @@
+/**
+ * RandomTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+
+using namespace c_plus_eight;
+
+// RND V0..VE, FF over and over: one pass per 16-cycle frame
+static std::vector<uint8_t> rnd_rom()
+{
+	std::vector<uint8_t> rom;
+	for (uint8_t x = 0; x < 0xF; x++) {
+		rom.push_back(0xC0 | x);
+		rom.push_back(0xFF);
+	}
+	rom.push_back(0x12);    // 21E: JP 200
+	rom.push_back(0x00);
+	return rom;
+}
+
+static std::vector<uint8_t> rnd_sequence(Chip8& emu, int frames)
+{
+	std::vector<uint8_t> values;
+	for (int frame = 0; frame < frames; frame++) {
+		emu.run_frame(16);
+		for (uint8_t x = 0; x < 0xF; x++) {
+			values.push_back(emu.get_register(x));
+		}
+	}
+	return values;
+}
+
+static std::vector<uint8_t> run_seeded(uint64_t seed, int frames)
+{
+	std::vector<uint8_t> rom = rnd_rom();
+	Chip8 emu(seed);
+	EXPECT_TRUE(emu.load_game(rom.data(), rom.size()));
+	return rnd_sequence(emu, frames);
+}
+
+// Machines started from the same seed draw the same numbers
+TEST(Random, SameSeedSameSequence)
+{
+	std::vector<uint8_t> a = run_seeded(1234, 8);
+	EXPECT_EQ(run_seeded(1234, 8), a);
+	EXPECT_NE(run_seeded(1235, 8), a);
+
+	// and the numbers are not stuck
+	EXPECT_NE(std::count(a.begin(), a.end(), a[0]), (long)a.size());
+}
+
+// seed() on a used machine restarts the generator exactly
+TEST(Random, ReseedReproducesSequence)
+{
+	std::vector<uint8_t> rom = rnd_rom();
+	Chip8 emu(77);
+	ASSERT_TRUE(emu.load_game(rom.data(), rom.size()));
+	std::vector<uint8_t> first = rnd_sequence(emu, 8);
+
+	emu.seed(77);
+	EXPECT_EQ(emu.get_seed(), 77u);
+	EXPECT_EQ(rnd_sequence(emu, 8), first);
+
+	// a default-constructed machine seeded later matches one built with that seed
+	Chip8 late;
+	ASSERT_TRUE(late.load_game(rom.data(), rom.size()));
+	rnd_sequence(late, 3);
+	late.seed(77);
+	EXPECT_EQ(rnd_sequence(late, 8), first);
+}
@@ -0,0 +1,107 @@
+/**
+ * RewindTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Rewind.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+// Snapshot after every frame of a ROM played with changing keys
+static std::vector<Chip8State> play(const char* rom, uint32_t frames)
+{
+	Chip8 emu(5);
+	EXPECT_TRUE(emu.load_game(test_rom_path(rom).c_str())) << rom;
+	std::vector<Chip8State> states(frames);
+	for (uint32_t f = 0; f < frames; f++) {
+		emu.set_keys(test_keys(2, f));
+		emu.run_frame(10);
+		emu.save_state(states[f]);
+	}
+	return states;
+}
+
+static bool same(const Chip8State& a, const Chip8State& b)
+{
+	return memcmp(&a, &b, sizeof(Chip8State)) == 0;
+}
+
+// Popping walks back through exactly the states that were pushed
+TEST(Rewind, PopsEveryPushedStateInReverse)
+{
+	for (const char* rom : TEST_ROMS) {
+		std::vector<Chip8State> states = play(rom, 600);
+		RewindBuffer buffer;
+		for (const Chip8State& s : states) {
+			buffer.push(s);
+		}
+		ASSERT_EQ(buffer.frames(), states.size() - 1) << rom;
+
+		Chip8State out;
+		for (size_t f = states.size() - 1; f-- > 0; ) {
+			ASSERT_TRUE(buffer.pop(out)) << rom;
+			ASSERT_TRUE(same(out, states[f])) << rom << " frame " << f;
+		}
+		EXPECT_FALSE(buffer.pop(out)) << rom;
+	}
+}
+
+// A full ring drops its oldest deltas but still rewinds exactly through the newest ones
+TEST(Rewind, FullRingKeepsNewestFrames)
+{
+	std::vector<Chip8State> states = play("INVADERS", 3000);
+	RewindBuffer buffer(16 * 1024);
+	for (const Chip8State& s : states) {
+		buffer.push(s);
+	}
+	size_t kept = buffer.frames();
+	ASSERT_GT(kept, 0u);
+	ASSERT_LT(kept, states.size() - 1);
+	EXPECT_LE(buffer.bytes_used(), 16u * 1024);
+
+	Chip8State out;
+	for (size_t k = 1; k <= kept; k++) {
+		ASSERT_TRUE(buffer.pop(out));
+		ASSERT_TRUE(same(out, states[states.size() - 1 - k])) << k;
+	}
+	EXPECT_FALSE(buffer.pop(out));
+}
+
+// Rewinding part way and playing on records the new branch in place of the old one
+TEST(Rewind, PushAfterPopReplacesHistory)
+{
+	std::vector<Chip8State> a = play("BRIX", 400);
+	std::vector<Chip8State> b = play("TANK", 100);
+	RewindBuffer buffer(64 * 1024);
+	for (const Chip8State& s : a) {
+		buffer.push(s);
+	}
+
+	Chip8State out;
+	for (size_t k = 0; k < 150; k++) {
+		ASSERT_TRUE(buffer.pop(out));
+	}
+	ASSERT_TRUE(same(out, a[a.size() - 151]));
+	for (const Chip8State& s : b) {
+		buffer.push(s);
+	}
+
+	for (size_t f = b.size() - 1; f-- > 0; ) {
+		ASSERT_TRUE(buffer.pop(out));
+		ASSERT_TRUE(same(out, b[f])) << f;
+	}
+	ASSERT_TRUE(buffer.pop(out));
+	EXPECT_TRUE(same(out, a[a.size() - 151]));
+	ASSERT_TRUE(buffer.pop(out));
+	EXPECT_TRUE(same(out, a[a.size() - 152]));
+
+	buffer.clear();
+	EXPECT_EQ(buffer.frames(), 0u);
+	EXPECT_FALSE(buffer.pop(out));
+}
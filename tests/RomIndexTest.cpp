@@ -0,0 +1,138 @@
+/**
+ * RomIndexTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <string.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "RomIndex.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+namespace fs = std::filesystem;
+
+#define TEST_ROM_COUNT (sizeof(TEST_ROMS) / sizeof(TEST_ROMS[0]))
+
+// A fresh directory holding a copy of every test ROM
+static fs::path make_rom_dir(const char* name)
+{
+	fs::path dir = fs::path(testing::TempDir()) / name;
+	fs::remove_all(dir);
+	fs::create_directories(dir / "roms");
+	for (const char* rom : TEST_ROMS) {
+		fs::copy_file(test_rom_path(rom), dir / "roms" / rom);
+	}
+	return dir;
+}
+
+static std::vector<char> read_file(const fs::path& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const fs::path& path, const std::vector<char>& data)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(data.data(), data.size());
+}
+
+// Every ROM is listed under its file name and its hash
+TEST(RomIndex, FindsRomsByNameAndHash)
+{
+	fs::path dir = make_rom_dir("c8-rom-index-find");
+	fs::path index_path = dir / "roms.c8ix";
+	RomIndexer indexer(60, 10, 2);
+	ASSERT_TRUE(indexer.build((dir / "roms").string().c_str(), index_path.string().c_str()));
+	EXPECT_EQ(indexer.get_indexed(), TEST_ROM_COUNT);
+	EXPECT_EQ(indexer.get_reused(), 0u);
+	EXPECT_FALSE(fs::exists(index_path.string() + ".tmp"));
+
+	RomIndex index;
+	ASSERT_TRUE(index.open(index_path.string().c_str()));
+	ASSERT_EQ(index.size(), TEST_ROM_COUNT);
+	EXPECT_EQ(index.get_header().frames, 60u);
+	EXPECT_EQ(index.get_header().cycles_per_frame, 10u);
+
+	for (const char* rom : TEST_ROMS) {
+		SCOPED_TRACE(rom);
+		Chip8 emu;
+		ASSERT_TRUE(emu.load_game(test_rom_path(rom).c_str()));
+
+		const RomIndexEntry* by_name = index.find(rom);
+		ASSERT_TRUE(by_name != NULL);
+		EXPECT_STREQ(index.name(*by_name), rom);
+		EXPECT_EQ(by_name->rom_hash, emu.get_rom_hash());
+		EXPECT_EQ(by_name->size, fs::file_size(test_rom_path(rom)));
+		EXPECT_EQ(index.find(emu.get_rom_hash()), by_name);
+	} // end for (rom)
+
+	EXPECT_TRUE(index.find("MISSING") == NULL);
+	EXPECT_TRUE(index.find((uint64_t)0) == NULL);
+}
+
+// Anything that is not a whole index is turned away, leaving the RomIndex empty
+TEST(RomIndex, RejectsTruncatedAndForeignFiles)
+{
+	fs::path dir = make_rom_dir("c8-rom-index-reject");
+	fs::path index_path = dir / "roms.c8ix";
+	RomIndexer indexer(10, 10, 1);
+	ASSERT_TRUE(indexer.build((dir / "roms").string().c_str(), index_path.string().c_str()));
+	std::vector<char> good = read_file(index_path);
+	ASSERT_GT(good.size(), sizeof(RomIndexHeader) + sizeof(RomIndexEntry));
+
+	std::vector<std::vector<char>> bad;
+	bad.emplace_back(good.begin(), good.begin() + sizeof(RomIndexHeader) + sizeof(RomIndexEntry));    // cut in the entries
+	bad.emplace_back(good.begin(), good.end() - 1);                                                     // cut in the strings
+	bad.emplace_back(good.begin(), good.begin() + 10);                                                  // cut in the header
+	bad.push_back(good);
+	memcpy(bad.back().data(), "C8SS", 4);
+
+	fs::path bad_path = dir / "bad.c8ix";
+	for (size_t b = 0; b < bad.size(); b++) {
+		write_file(bad_path, bad[b]);
+		RomIndex index;
+		EXPECT_FALSE(index.open(bad_path.string().c_str())) << "file " << b;
+		EXPECT_EQ(index.size(), 0u) << "file " << b;
+	} // end for (b)
+
+	RomIndex index;
+	EXPECT_TRUE(index.open(index_path.string().c_str()));
+}
+
+// Rebuilding over the previous index reads only the files that changed since
+TEST(RomIndex, ReusesUnchangedEntries)
+{
+	fs::path dir = make_rom_dir("c8-rom-index-reuse");
+	fs::path roms = dir / "roms";
+	fs::path index_path = dir / "roms.c8ix";
+	RomIndexer first(30, 10, 2);
+	ASSERT_TRUE(first.build(roms.string().c_str(), index_path.string().c_str()));
+
+	// PONG gets a byte appended, which changes its size
+	std::vector<char> pong = read_file(roms / "PONG");
+	pong.push_back(0);
+	write_file(roms / "PONG", pong);
+
+	RomIndex previous;
+	ASSERT_TRUE(previous.open(index_path.string().c_str()));
+	uint64_t brix_hash = previous.find("BRIX")->rom_hash;
+
+	RomIndexer second(30, 10, 2);
+	ASSERT_TRUE(second.build(roms.string().c_str(), index_path.string().c_str(), &previous));
+	EXPECT_EQ(second.get_reused(), TEST_ROM_COUNT - 1);
+	EXPECT_EQ(second.get_indexed(), 1u);
+
+	RomIndex index;
+	ASSERT_TRUE(index.open(index_path.string().c_str()));
+	ASSERT_EQ(index.size(), TEST_ROM_COUNT);
+	EXPECT_EQ(index.find("BRIX")->rom_hash, brix_hash);
+	EXPECT_EQ(index.find("PONG")->size, pong.size());
+}
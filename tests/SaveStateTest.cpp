@@ -0,0 +1,84 @@
+/**
+ * SaveStateTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+#include "TestRoms.h"
+
+using namespace c_plus_eight;
+
+// A machine restored mid-game runs on exactly like the one it was saved from
+TEST(SaveState, RoundTripContinuesIdentically)
+{
+	for (const char* rom : TEST_ROMS) {
+		Chip8 emu(7);
+		ASSERT_TRUE(emu.load_game(test_rom_path(rom).c_str())) << rom;
+		for (uint32_t f = 0; f < 300; f++) {
+			emu.set_keys(test_keys(1, f));
+			emu.run_frame(10);
+		}
+
+		std::vector<uint8_t> blob(SAVE_STATE_SIZE);
+		ASSERT_EQ(emu.save_state(blob.data(), blob.size()), SAVE_STATE_SIZE);
+
+		Chip8 copy;
+		ASSERT_TRUE(copy.load_state(blob.data(), blob.size())) << rom;
+		EXPECT_EQ(copy.state_hash(), emu.state_hash()) << rom;
+		EXPECT_EQ(copy.frame_hash(), emu.frame_hash()) << rom;
+
+		for (uint32_t f = 300; f < 600; f++) {
+			emu.set_keys(test_keys(1, f));
+			emu.run_frame(10);
+			copy.set_keys(test_keys(1, f));
+			copy.run_frame(10);
+		}
+		EXPECT_EQ(copy.state_hash(), emu.state_hash()) << rom;
+		EXPECT_EQ(copy.get_cycles(), emu.get_cycles()) << rom;
+	}
+}
+
+TEST(SaveState, RejectsTruncatedAndForeignBlobs)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(test_rom_path("BRIX").c_str()));
+	std::vector<uint8_t> blob(SAVE_STATE_SIZE);
+	ASSERT_EQ(emu.save_state(blob.data(), blob.size()), SAVE_STATE_SIZE);
+
+	Chip8 other;
+	EXPECT_FALSE(other.load_state(blob.data(), blob.size() - 1));
+	EXPECT_EQ(other.save_state(blob.data(), blob.size() - 1), 0u);
+
+	blob[0] = 'X';
+	EXPECT_FALSE(other.load_state(blob.data(), blob.size()));
+}
+
+// Registers that index the stack or V must be in range, or CALL and key_press would write past them
+TEST(SaveState, RejectsOutOfRangeRegisters)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(test_rom_path("BRIX").c_str()));
+	std::vector<uint8_t> good(SAVE_STATE_SIZE);
+	ASSERT_EQ(emu.save_state(good.data(), good.size()), SAVE_STATE_SIZE);
+
+	const size_t regs = sizeof(SaveStateHeader) + offsetof(Chip8State, regs);
+	const size_t fields[] = { offsetof(Chip8Registers, sp), offsetof(Chip8Registers, key_wait_reg),
+		offsetof(Chip8Registers, waiting_for_key) };
+	for (size_t field : fields) {
+		std::vector<uint8_t> blob = good;
+		blob[regs + field] = 0x11;
+
+		Chip8 target(1);
+		ASSERT_TRUE(target.load_game(test_rom_path("PONG").c_str()));
+		uint64_t before = target.state_hash();
+		EXPECT_FALSE(target.load_state(blob.data(), blob.size())) << "field at " << field;
+		EXPECT_EQ(target.state_hash(), before) << "a rejected state must leave the machine alone";
+	}
+
+	Chip8 target;
+	EXPECT_TRUE(target.load_state(good.data(), good.size()));
+}
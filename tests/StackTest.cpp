@@ -0,0 +1,59 @@
+/**
+ * StackTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+
+using namespace c_plus_eight;
+
+// Each instruction calls the next, depth times, then the program loops at the end
+static std::vector<uint8_t> nested_calls_rom(int depth)
+{
+	std::vector<uint8_t> rom;
+	for (int i = 0; i < depth; i++) {
+		uint16_t next = 0x200 + (i + 1) * 2;
+		rom.push_back(0x20 | (next >> 8));
+		rom.push_back(next & 0xFF);
+	}
+	uint16_t end = 0x200 + depth * 2;
+	rom.push_back(0x10 | (end >> 8));
+	rom.push_back(end & 0xFF);
+	return rom;
+}
+
+// All 16 entries can be used
+TEST(Stack, HoldsSixteenCalls)
+{
+	std::vector<uint8_t> rom = nested_calls_rom(16);
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(rom.data(), rom.size()));
+	emu.run_frame(20);
+	EXPECT_EQ(emu.get_pc(), 0x220);
+}
+
+// The 17th nested CALL faults and leaves pc on it
+TEST(Stack, OverflowThrows)
+{
+	std::vector<uint8_t> rom = nested_calls_rom(17);
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(rom.data(), rom.size()));
+	EXPECT_THROW(emu.run_frame(20), stack_error);
+	EXPECT_EQ(emu.get_pc(), 0x220);
+	EXPECT_THROW(emu.emulate_cycle(), stack_error);
+}
+
+// RET with nothing to return to faults
+TEST(Stack, UnderflowThrows)
+{
+	static const uint8_t rom[] = { 0x60, 0x01, 0x00, 0xEE };   // LD V0, 1; RET
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(rom, sizeof(rom)));
+	EXPECT_THROW(emu.run_frame(10), machine_fault);
+	EXPECT_EQ(emu.get_pc(), 0x202);
+	EXPECT_EQ(emu.get_register(0), 1);
+}
@@ -0,0 +1,93 @@
+/**
+ * StateHashTest.cpp
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Chip8.h"
+#include "TranspositionTable.h"
+
+using namespace c_plus_eight;
+
+// Returns from one subroutine, then calls another that loops for good: stack[0] ends up live, stack[1] dead
+static const uint8_t CALLS_ROM[] = {
+	0x22, 0x08,     // 200: CALL 208
+	0x22, 0x0C,     // 202: CALL 20C
+	0x12, 0x04,     // 204: JP 204
+	0x00, 0x00,
+	0x22, 0x0E,     // 208: CALL 20E
+	0x00, 0xEE,     // 20A: RET
+	0x12, 0x0C,     // 20C: JP 20C
+	0x00, 0xEE,     // 20E: RET
+};
+
+static const size_t STACK_OFFSET = sizeof(SaveStateHeader) + offsetof(Chip8State, regs) + offsetof(Chip8Registers, stack);
+
+static uint64_t hash_with_stack_entry(const std::vector<uint8_t>& state, size_t entry, uint16_t value)
+{
+	std::vector<uint8_t> blob = state;
+	memcpy(&blob[STACK_OFFSET + entry * sizeof(uint16_t)], &value, sizeof(value));
+	Chip8 emu;
+	EXPECT_TRUE(emu.load_state(blob.data(), blob.size()));
+	return emu.state_hash();
+}
+
+// Return addresses left behind by RET do not make otherwise equal states distinct
+TEST(StateHash, IgnoresDeadStackEntries)
+{
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(CALLS_ROM, sizeof(CALLS_ROM)));
+	emu.run_frame(10);
+	ASSERT_EQ(emu.get_pc(), 0x20C);
+
+	std::vector<uint8_t> state(SAVE_STATE_SIZE);
+	ASSERT_EQ(emu.save_state(state.data(), state.size()), SAVE_STATE_SIZE);
+	uint64_t h = emu.state_hash();
+
+	// stack[1] held 20A until the RET; anything there now is dead
+	EXPECT_EQ(hash_with_stack_entry(state, 1, 0x0000), h);
+	EXPECT_EQ(hash_with_stack_entry(state, 15, 0x0ABC), h);
+
+	// stack[0] is where the loop would return to
+	EXPECT_NE(hash_with_stack_entry(state, 0, 0x0206), h);
+
+	TranspositionTable seen(1024);
+	EXPECT_TRUE(seen.visit(h));
+	EXPECT_FALSE(seen.visit(hash_with_stack_entry(state, 1, 0x0000)));
+	EXPECT_TRUE(seen.visit(hash_with_stack_entry(state, 0, 0x0206)));
+}
+
+
+// With all 16 entries in use every one of them is live
+TEST(StateHash, HashesFullStack)
+{
+	std::vector<uint8_t> rom;
+	for (uint16_t next = 0x202; next <= 0x220; next += 2) {
+		rom.push_back(0x20 | (next >> 8));     // CALL next
+		rom.push_back(next & 0xFF);
+	}
+	rom.push_back(0x12);                        // 220: JP 220
+	rom.push_back(0x20);
+
+	Chip8 emu;
+	ASSERT_TRUE(emu.load_game(rom.data(), rom.size()));
+	emu.run_frame(20);
+	ASSERT_EQ(emu.get_pc(), 0x220);
+
+	std::vector<uint8_t> state(SAVE_STATE_SIZE);
+	ASSERT_EQ(emu.save_state(state.data(), state.size()), SAVE_STATE_SIZE);
+	uint64_t h = emu.state_hash();
+	EXPECT_NE(hash_with_stack_entry(state, 0, 0x0000), h);
+	EXPECT_NE(hash_with_stack_entry(state, 15, 0x0000), h);
+
+	// nor does a full stack look like an empty one
+	std::vector<uint8_t> empty = state;
+	empty[sizeof(SaveStateHeader) + offsetof(Chip8State, regs) + offsetof(Chip8Registers, sp)] = 0;
+	Chip8 other;
+	ASSERT_TRUE(other.load_state(empty.data(), empty.size()));
+	EXPECT_NE(other.state_hash(), h);
+}
@@ -0,0 +1,28 @@
+/**
+ * TestRoms.h
+ * Copyright (c) 2020 Daniel Buckley
+ */
+
+#pragma once
+
+#include <string>
+
+#include "Chip8.h"
+#include "Hash.h"
+
+namespace c_plus_eight {
+	/* ROMs the tests run, all from c8games */
+	static const char* const TEST_ROMS[] = { "BLITZ", "BRIX", "INVADERS", "PONG", "TANK", "TETRIS", "UFO" };
+
+	inline std::string test_rom_path(const char* name)
+	{
+		return std::string(C8_TEST_ROMS) + "/" + name;
+	}
+
+	/* Keypad state that changes every few frames, different for every seed */
+	inline uint16_t test_keys(uint64_t seed, uint32_t frame)
+	{
+		uint64_t h = hash64_key(seed, frame / 7);
+		return ((h & 3) == 0) ? (uint16_t)(1u << ((h >> 8) & 0xF)) : 0;
+	}
+}